@@ -0,0 +1,216 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define CALIBRATE_ROUNDS 1001
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+double bench_calibrate(void)
+{
+    long long t[CALIBRATE_ROUNDS];
+
+    for (int i = 0; i < CALIBRATE_ROUNDS; ++i) {
+        long long t1 = bench_now();
+        t[i] = bench_now() - t1;
+    }
+    qsort(t, CALIBRATE_ROUNDS, sizeof(t[0]), cmp_ll);
+    return t[CALIBRATE_ROUNDS / 2];
+}
+
+void bench_hist_reset(struct bench_hist *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+static unsigned int hist_index(uint64_t v)
+{
+    if (v < BENCH_HIST_SUB)
+        return v;
+
+    /* e >= 6: keep the 6 bits below the leading one */
+    unsigned int e = 63 - __builtin_clzll(v);
+    return (e - 5) * BENCH_HIST_SUB + ((v >> (e - 6)) & (BENCH_HIST_SUB - 1));
+}
+
+/* midpoint of a bucket, in units of 0.1 ns */
+static double hist_value(unsigned int idx)
+{
+    if (idx < BENCH_HIST_SUB)
+        return idx;
+
+    unsigned int e = idx / BENCH_HIST_SUB + 5;
+    uint64_t width = 1ULL << (e - 6);
+    return (double) ((BENCH_HIST_SUB + idx % BENCH_HIST_SUB) * width) +
+           (width - 1) / 2.0;
+}
+
+void bench_hist_add(struct bench_hist *h, double ns, uint64_t weight)
+{
+    if (ns < 0)
+        ns = 0;
+    h->buckets[hist_index((uint64_t) (ns * 10))] += weight;
+    h->count += weight;
+    h->sum += ns * weight;
+    if (ns > h->max)
+        h->max = ns;
+}
+
+/* Smallest recorded value, in ns, that at least a fraction @q of the
+ * samples do not exceed.
+ */
+double bench_hist_percentile(const struct bench_hist *h, double q)
+{
+    uint64_t target = ceil(q * h->count), seen = 0;
+
+    if (!target)
+        target = 1;
+    for (unsigned int i = 0; i < BENCH_HIST_BUCKETS; ++i) {
+        seen += h->buckets[i];
+        if (seen >= target)
+            return hist_value(i) / 10;
+    }
+    return h->max;
+}
+
+void zipf_init(struct zipf *z, size_t n, double s)
+{
+    double sum = 0;
+
+    z->n = n;
+    z->cdf = NULL;
+    z->keys = NULL;
+    if (!n)
+        return;
+    z->cdf = malloc(sizeof(double) * n);
+    z->keys = malloc(sizeof(int) * n);
+    assert(z->cdf && z->keys);
+
+    for (size_t i = 0; i < n; ++i) {
+        sum += 1.0 / pow(i + 1, s);
+        z->cdf[i] = sum;
+        z->keys[i] = i;
+    }
+    for (size_t i = 0; i < n; ++i)
+        z->cdf[i] /= sum;
+
+    for (size_t i = n - 1; i > 0; --i) {
+        size_t j = rand() % (i + 1);
+        int tmp = z->keys[i];
+        z->keys[i] = z->keys[j];
+        z->keys[j] = tmp;
+    }
+}
+
+int zipf_next(struct zipf *z)
+{
+    double u = (double) rand() / RAND_MAX;
+    size_t lo = 0, hi = z->n - 1;
+
+    if (!z->n)
+        return 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (z->cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return z->keys[lo];
+}
+
+void zipf_free(struct zipf *z)
+{
+    free(z->cdf);
+    free(z->keys);
+}
+
+static const char *const dist_names[] = {
+    [BENCH_UNIFORM] = "uniform",
+    [BENCH_ZIPF] = "zipf",
+    [BENCH_SEQUENTIAL] = "sequential",
+};
+
+const char *bench_dist_name(enum bench_dist dist)
+{
+    return dist_names[dist];
+}
+
+int bench_dist_parse(const char *name, enum bench_dist *dist)
+{
+    for (size_t i = 0; i < sizeof(dist_names) / sizeof(dist_names[0]); ++i) {
+        if (!strcmp(name, dist_names[i])) {
+            *dist = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* @path "-" is the standard output. */
+int bench_out_open(struct bench_out *out, const char *path,
+                   enum bench_format format)
+{
+    out->f = strcmp(path, "-") ? fopen(path, "w") : stdout;
+    out->format = format;
+    out->records = 0;
+    if (!out->f)
+        return -1;
+
+    if (format == BENCH_CSV)
+        fprintf(out->f,
+                "tree,read_pct,dist,zipf_s,tree_size,ops,warmup,reps,batch,"
+                "timer_ns,mops,mops_sd,mean_ns,batch_p50_ns,batch_p99_ns,"
+                "batch_p999_ns,batch_max_ns\n");
+    else
+        fprintf(out->f, "[");
+    return 0;
+}
+
+void bench_out_record(struct bench_out *out,
+                      const char *tree,
+                      const struct bench_mix *mix,
+                      const struct bench_result *r)
+{
+    if (out->format == BENCH_CSV) {
+        fprintf(out->f,
+                "\"%s\",%u,%s,%g,%zu,%zu,%zu,%u,%u,%.1f,%.3f,%.3f,%.1f,%.1f,"
+                "%.1f,%.1f,%.1f\n",
+                tree, mix->read_pct, bench_dist_name(mix->dist), mix->zipf_s,
+                r->tree_size, mix->ops, mix->warmup, mix->reps, mix->batch,
+                r->timer_ns, r->mops, r->mops_sd, r->mean_ns,
+                r->batch_p50_ns, r->batch_p99_ns, r->batch_p999_ns,
+                r->batch_max_ns);
+    } else {
+        fprintf(out->f,
+                "%s\n  {\"tree\": \"%s\", \"read_pct\": %u, \"dist\": \"%s\", "
+                "\"zipf_s\": %g, \"tree_size\": %zu, \"ops\": %zu, "
+                "\"warmup\": %zu, \"reps\": %u, \"batch\": %u, "
+                "\"timer_ns\": %.1f, \"mops\": %.3f, \"mops_sd\": %.3f, "
+                "\"mean_ns\": %.1f, \"batch_p50_ns\": %.1f, "
+                "\"batch_p99_ns\": %.1f, \"batch_p999_ns\": %.1f, "
+                "\"batch_max_ns\": %.1f}",
+                out->records ? "," : "", tree, mix->read_pct,
+                bench_dist_name(mix->dist), mix->zipf_s, r->tree_size,
+                mix->ops, mix->warmup, mix->reps, mix->batch, r->timer_ns,
+                r->mops, r->mops_sd, r->mean_ns, r->batch_p50_ns,
+                r->batch_p99_ns, r->batch_p999_ns, r->batch_max_ns);
+    }
+    out->records++;
+}
+
+int bench_out_close(struct bench_out *out)
+{
+    if (out->format == BENCH_JSON)
+        fprintf(out->f, "\n]\n");
+    if (out->f == stdout)
+        return fflush(stdout);
+    return fclose(out->f);
+}
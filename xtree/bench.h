@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Measurement harness for the treeint benchmark.
+ *
+ * A clock_gettime() pair costs about as much as a tree lookup, so timing
+ * every operation on its own mostly measures the clock. The harness times
+ * batches of operations instead, subtracts the calibrated cost of reading
+ * the clock once per batch, and records the per-operation mean of each
+ * batch in a latency histogram. Percentiles are thus percentiles of batch
+ * means: a batch of 1 gives true per-operation latencies, at the price of
+ * the clock overhead dominating fast operations.
+ */
+static inline long long bench_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* Median cost in ns of two back-to-back bench_now() calls. */
+double bench_calibrate(void);
+
+/* Log-linear latency histogram in units of 0.1 ns: values below
+ * BENCH_HIST_SUB are exact, larger ones land in one of BENCH_HIST_SUB
+ * buckets per power of two, which bounds the relative error by 1/64.
+ */
+#define BENCH_HIST_SUB 64
+#define BENCH_HIST_BUCKETS (59 * BENCH_HIST_SUB)
+
+struct bench_hist {
+    uint64_t count;
+    double sum; /* ns */
+    double max; /* ns */
+    uint64_t buckets[BENCH_HIST_BUCKETS];
+};
+
+void bench_hist_reset(struct bench_hist *h);
+void bench_hist_add(struct bench_hist *h, double ns, uint64_t weight);
+double bench_hist_percentile(const struct bench_hist *h, double q);
+
+/* Zipf distributed ranks: rank r in [1, n] is drawn with a probability
+ * proportional to 1 / r^s. Ranks are mapped to keys through a random
+ * permutation so that the hot keys are spread over the whole key space.
+ */
+struct zipf {
+    size_t n;
+    double *cdf;
+    int *keys;
+};
+
+void zipf_init(struct zipf *z, size_t n, double s);
+int zipf_next(struct zipf *z);
+void zipf_free(struct zipf *z);
+
+/* A mixed workload: each operation is a find with probability read_pct %,
+ * otherwise an insert or a remove with equal odds, so the tree keeps its
+ * size. Keys are drawn from a domain of 2 * tree_size keys, half of which
+ * are inserted beforehand.
+ */
+enum bench_dist {
+    BENCH_UNIFORM,
+    BENCH_ZIPF,
+    BENCH_SEQUENTIAL,
+};
+
+struct bench_mix {
+    unsigned int read_pct;
+    enum bench_dist dist;
+    double zipf_s;
+    size_t ops;    /* timed operations per repetition */
+    size_t warmup; /* untimed operations before the first repetition */
+    unsigned int reps;
+    unsigned int batch; /* operations per clock reading */
+};
+
+const char *bench_dist_name(enum bench_dist dist);
+int bench_dist_parse(const char *name, enum bench_dist *dist);
+
+struct bench_result {
+    size_t tree_size;
+    double timer_ns;    /* calibrated overhead subtracted from each batch */
+    double mops, mops_sd; /* throughput over the repetitions, in ops/us */
+    double mean_ns; /* per operation */
+    /* percentiles and maximum of the per-operation means of the batches,
+     * which are per-operation latencies only with batches of 1
+     */
+    double batch_p50_ns, batch_p99_ns, batch_p999_ns, batch_max_ns;
+};
+
+/* Machine readable records, one per tree and workload, for trend tracking.
+ * CSV starts with a header line, JSON is an array of objects.
+ */
+enum bench_format {
+    BENCH_CSV,
+    BENCH_JSON,
+};
+
+struct bench_out {
+    FILE *f;
+    enum bench_format format;
+    size_t records;
+};
+
+int bench_out_open(struct bench_out *out, const char *path,
+                   enum bench_format format);
+void bench_out_record(struct bench_out *out,
+                      const char *tree,
+                      const struct bench_mix *mix,
+                      const struct bench_result *r);
+int bench_out_close(struct bench_out *out);
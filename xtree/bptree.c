@@ -0,0 +1,577 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bptree.h"
+#include "pool.h"
+
+struct bpt_hdr {
+    uint16_t nkeys;
+    uint16_t leaf;
+};
+
+/* Key counts are multiples of the vector width, so that the in-node search
+ * vectorizes without a scalar tail.
+ */
+#define BPT_LEAF_KEYS 56
+#define BPT_INNER_KEYS 20
+#define BPT_LEAF_MIN (BPT_LEAF_KEYS / 2)
+#define BPT_INNER_MIN (BPT_INNER_KEYS / 2)
+/* a fanout of at least BPT_INNER_MIN + 1 bounds the depth for 2^32 keys */
+#define BPT_MAX_DEPTH 16
+
+struct bpt_leaf {
+    struct bpt_hdr hdr;
+    int keys[BPT_LEAF_KEYS]; /* unused slots hold INT_MAX */
+    struct bpt_leaf *prev, *next;
+} __attribute__((aligned(64)));
+
+/* child[i] holds the keys k with keys[i - 1] <= k < keys[i] */
+struct bpt_inner {
+    struct bpt_hdr hdr;
+    int keys[BPT_INNER_KEYS]; /* unused slots hold INT_MAX */
+    struct bpt_hdr *child[BPT_INNER_KEYS + 1];
+} __attribute__((aligned(64)));
+
+_Static_assert(sizeof(struct bpt_leaf) == BPT_NODE_SIZE, "leaf size");
+_Static_assert(sizeof(struct bpt_inner) == BPT_NODE_SIZE, "inner node size");
+
+struct bptree {
+    struct bpt_hdr *root; /* an empty leaf when the tree is empty */
+    struct bpt_leaf *head; /* leftmost leaf */
+    int height;
+    size_t count; /* keys in the leaves */
+    struct node_pool pool;
+};
+
+#define bpt_leaf(h) ((struct bpt_leaf *) (h))
+#define bpt_inner(h) ((struct bpt_inner *) (h))
+
+/* Number of keys smaller than @key. Branch-free over the whole array: the
+ * INT_MAX padding is never counted.
+ */
+static inline unsigned int bpt_rank(const int *keys, unsigned int cap, int key)
+{
+    unsigned int r = 0;
+
+    for (unsigned int i = 0; i < cap; i++)
+        r += keys[i] < key;
+    return r;
+}
+
+/* Index of the child of @n covering @key */
+static inline unsigned int bpt_child(const struct bpt_inner *n, int key)
+{
+    unsigned int r = 0;
+
+    for (unsigned int i = 0; i < BPT_INNER_KEYS; i++)
+        r += n->keys[i] <= key;
+    /* the padding matches too when @key is INT_MAX */
+    return r < n->hdr.nkeys ? r : n->hdr.nkeys;
+}
+
+static struct bpt_leaf *bpt_leaf_alloc(struct bptree *t)
+{
+    struct bpt_leaf *l = pool_alloc(&t->pool);
+    assert(l);
+
+    l->hdr.leaf = 1;
+    for (unsigned int i = 0; i < BPT_LEAF_KEYS; i++)
+        l->keys[i] = INT_MAX;
+    return l;
+}
+
+static struct bpt_inner *bpt_inner_alloc(struct bptree *t)
+{
+    struct bpt_inner *n = pool_alloc(&t->pool);
+    assert(n);
+
+    for (unsigned int i = 0; i < BPT_INNER_KEYS; i++)
+        n->keys[i] = INT_MAX;
+    return n;
+}
+
+static inline void bpt_leaf_insert_at(struct bpt_leaf *l,
+                                      unsigned int pos,
+                                      int key)
+{
+    memmove(&l->keys[pos + 1], &l->keys[pos],
+            sizeof(int) * (l->hdr.nkeys - pos));
+    l->keys[pos] = key;
+    l->hdr.nkeys++;
+}
+
+static inline void bpt_leaf_remove_at(struct bpt_leaf *l, unsigned int pos)
+{
+    l->hdr.nkeys--;
+    memmove(&l->keys[pos], &l->keys[pos + 1],
+            sizeof(int) * (l->hdr.nkeys - pos));
+    l->keys[l->hdr.nkeys] = INT_MAX;
+}
+
+/* Insert separator @key at @pos, with the child on its right */
+static inline void bpt_inner_insert_at(struct bpt_inner *n,
+                                       unsigned int pos,
+                                       int key,
+                                       struct bpt_hdr *child)
+{
+    memmove(&n->keys[pos + 1], &n->keys[pos],
+            sizeof(int) * (n->hdr.nkeys - pos));
+    memmove(&n->child[pos + 2], &n->child[pos + 1],
+            sizeof(struct bpt_hdr *) * (n->hdr.nkeys - pos));
+    n->keys[pos] = key;
+    n->child[pos + 1] = child;
+    n->hdr.nkeys++;
+}
+
+/* Remove separator @pos along with the child on its right */
+static inline void bpt_inner_remove_at(struct bpt_inner *n, unsigned int pos)
+{
+    n->hdr.nkeys--;
+    memmove(&n->keys[pos], &n->keys[pos + 1],
+            sizeof(int) * (n->hdr.nkeys - pos));
+    memmove(&n->child[pos + 1], &n->child[pos + 2],
+            sizeof(struct bpt_hdr *) * (n->hdr.nkeys - pos));
+    n->keys[n->hdr.nkeys] = INT_MAX;
+    n->child[n->hdr.nkeys + 1] = NULL;
+}
+
+void *bptree_init()
+{
+    struct bptree *t = calloc(sizeof(struct bptree), 1);
+    assert(t);
+
+    pool_init(&t->pool, BPT_NODE_SIZE, TREEINT_POOL_CHUNK);
+    t->head = bpt_leaf_alloc(t);
+    t->root = &t->head->hdr;
+    t->height = 1;
+    return t;
+}
+
+int bptree_destroy(void *ctx)
+{
+    struct bptree *t = (struct bptree *) ctx;
+
+    pool_destroy(&t->pool);
+    free(t);
+    return 0;
+}
+
+static struct bpt_leaf *bpt_find_leaf(struct bptree *t, int a)
+{
+    struct bpt_hdr *n = t->root;
+
+    while (!n->leaf)
+        n = bpt_inner(n)->child[bpt_child(bpt_inner(n), a)];
+    return bpt_leaf(n);
+}
+
+/* Split the full leaf @l around the insertion of @a at @pos. The new right
+ * leaf is returned, its smallest key being the separator.
+ */
+static struct bpt_leaf *bpt_split_leaf(struct bptree *t,
+                                       struct bpt_leaf *l,
+                                       unsigned int pos,
+                                       int a)
+{
+    struct bpt_leaf *r = bpt_leaf_alloc(t);
+    unsigned int mid = BPT_LEAF_KEYS / 2;
+
+    r->hdr.nkeys = BPT_LEAF_KEYS - mid;
+    memcpy(r->keys, &l->keys[mid], sizeof(int) * r->hdr.nkeys);
+    for (unsigned int i = mid; i < BPT_LEAF_KEYS; i++)
+        l->keys[i] = INT_MAX;
+    l->hdr.nkeys = mid;
+
+    if (pos <= mid)
+        bpt_leaf_insert_at(l, pos, a);
+    else
+        bpt_leaf_insert_at(r, pos - mid, a);
+
+    r->prev = l;
+    r->next = l->next;
+    if (l->next)
+        l->next->prev = r;
+    l->next = r;
+    return r;
+}
+
+/* Split the full inner node @n around the insertion of separator @key and
+ * @child at @pos. The new right node is returned, and the separator moving
+ * up to the parent stored in *up.
+ */
+static struct bpt_inner *bpt_split_inner(struct bptree *t,
+                                         struct bpt_inner *n,
+                                         unsigned int pos,
+                                         int key,
+                                         struct bpt_hdr *child,
+                                         int *up)
+{
+    int keys[BPT_INNER_KEYS + 1];
+    struct bpt_hdr *children[BPT_INNER_KEYS + 2];
+    unsigned int total = BPT_INNER_KEYS + 1, mid = total / 2;
+    struct bpt_inner *r = bpt_inner_alloc(t);
+
+    memcpy(keys, n->keys, sizeof(int) * pos);
+    keys[pos] = key;
+    memcpy(&keys[pos + 1], &n->keys[pos],
+           sizeof(int) * (BPT_INNER_KEYS - pos));
+    memcpy(children, n->child, sizeof(struct bpt_hdr *) * (pos + 1));
+    children[pos + 1] = child;
+    memcpy(&children[pos + 2], &n->child[pos + 1],
+           sizeof(struct bpt_hdr *) * (BPT_INNER_KEYS - pos));
+
+    for (unsigned int i = 0; i < BPT_INNER_KEYS; i++)
+        n->keys[i] = i < mid ? keys[i] : INT_MAX;
+    for (unsigned int i = 0; i <= BPT_INNER_KEYS; i++)
+        n->child[i] = i <= mid ? children[i] : NULL;
+    n->hdr.nkeys = mid;
+
+    *up = keys[mid];
+
+    r->hdr.nkeys = total - mid - 1;
+    memcpy(r->keys, &keys[mid + 1], sizeof(int) * r->hdr.nkeys);
+    memcpy(r->child, &children[mid + 1],
+           sizeof(struct bpt_hdr *) * (r->hdr.nkeys + 1));
+    return r;
+}
+
+int bptree_insert(void *ctx, int a)
+{
+    struct bptree *t = (struct bptree *) ctx;
+    struct bpt_inner *path[BPT_MAX_DEPTH];
+    unsigned int idx[BPT_MAX_DEPTH];
+    struct bpt_hdr *n = t->root;
+    int depth = 0;
+
+    while (!n->leaf) {
+        unsigned int c = bpt_child(bpt_inner(n), a);
+        path[depth] = bpt_inner(n);
+        idx[depth++] = c;
+        n = bpt_inner(n)->child[c];
+    }
+
+    struct bpt_leaf *l = bpt_leaf(n);
+    unsigned int pos = bpt_rank(l->keys, BPT_LEAF_KEYS, a);
+    if (pos < l->hdr.nkeys && l->keys[pos] == a)
+        return -1;
+
+    t->count++;
+    if (l->hdr.nkeys < BPT_LEAF_KEYS) {
+        bpt_leaf_insert_at(l, pos, a);
+        return 0;
+    }
+
+    /* Split on the way back up, as long as the parent is full too */
+    struct bpt_leaf *r = bpt_split_leaf(t, l, pos, a);
+    struct bpt_hdr *child = &r->hdr;
+    int sep = r->keys[0];
+
+    while (depth > 0) {
+        struct bpt_inner *p = path[--depth];
+        unsigned int c = idx[depth];
+
+        if (p->hdr.nkeys < BPT_INNER_KEYS) {
+            bpt_inner_insert_at(p, c, sep, child);
+            return 0;
+        }
+        child = &bpt_split_inner(t, p, c, sep, child, &sep)->hdr;
+    }
+
+    struct bpt_inner *root = bpt_inner_alloc(t);
+    root->hdr.nkeys = 1;
+    root->keys[0] = sep;
+    root->child[0] = t->root;
+    root->child[1] = child;
+    t->root = &root->hdr;
+    t->height++;
+    assert(t->height <= BPT_MAX_DEPTH);
+    return 0;
+}
+
+void *bptree_find(void *ctx, int a)
+{
+    struct bpt_leaf *l = bpt_find_leaf((struct bptree *) ctx, a);
+    unsigned int pos = bpt_rank(l->keys, BPT_LEAF_KEYS, a);
+
+    return pos < l->hdr.nkeys && l->keys[pos] == a ? &l->keys[pos] : NULL;
+}
+
+/* Refill the leaf child @c of @p, which fell below BPT_LEAF_MIN keys, from a
+ * sibling, or merge the two. Returns true when @p lost a child.
+ */
+static bool bpt_fix_leaf(struct bptree *t, struct bpt_inner *p, unsigned int c)
+{
+    struct bpt_leaf *l = bpt_leaf(p->child[c]);
+    struct bpt_leaf *left = c > 0 ? bpt_leaf(p->child[c - 1]) : NULL;
+    struct bpt_leaf *right =
+        c < p->hdr.nkeys ? bpt_leaf(p->child[c + 1]) : NULL;
+
+    if (left && left->hdr.nkeys > BPT_LEAF_MIN) {
+        bpt_leaf_insert_at(l, 0, left->keys[left->hdr.nkeys - 1]);
+        bpt_leaf_remove_at(left, left->hdr.nkeys - 1);
+        p->keys[c - 1] = l->keys[0];
+        return false;
+    }
+    if (right && right->hdr.nkeys > BPT_LEAF_MIN) {
+        bpt_leaf_insert_at(l, l->hdr.nkeys, right->keys[0]);
+        bpt_leaf_remove_at(right, 0);
+        p->keys[c] = right->keys[0];
+        return false;
+    }
+
+    /* merge the right one of the pair into the left one */
+    if (left) {
+        right = l;
+        l = left;
+        c--;
+    }
+    memcpy(&l->keys[l->hdr.nkeys], right->keys,
+           sizeof(int) * right->hdr.nkeys);
+    l->hdr.nkeys += right->hdr.nkeys;
+    l->next = right->next;
+    if (right->next)
+        right->next->prev = l;
+    bpt_inner_remove_at(p, c);
+    pool_free(&t->pool, right);
+    return true;
+}
+
+/* Same as bpt_fix_leaf() for an inner child, below BPT_INNER_MIN keys: keys
+ * rotate through the separator in @p.
+ */
+static bool bpt_fix_inner(struct bptree *t, struct bpt_inner *p, unsigned int c)
+{
+    struct bpt_inner *n = bpt_inner(p->child[c]);
+    struct bpt_inner *left = c > 0 ? bpt_inner(p->child[c - 1]) : NULL;
+    struct bpt_inner *right =
+        c < p->hdr.nkeys ? bpt_inner(p->child[c + 1]) : NULL;
+
+    if (left && left->hdr.nkeys > BPT_INNER_MIN) {
+        unsigned int ln = left->hdr.nkeys;
+
+        memmove(&n->keys[1], n->keys, sizeof(int) * n->hdr.nkeys);
+        memmove(&n->child[1], n->child,
+                sizeof(struct bpt_hdr *) * (n->hdr.nkeys + 1));
+        n->keys[0] = p->keys[c - 1];
+        n->child[0] = left->child[ln];
+        n->hdr.nkeys++;
+        p->keys[c - 1] = left->keys[ln - 1];
+        left->keys[ln - 1] = INT_MAX;
+        left->child[ln] = NULL;
+        left->hdr.nkeys--;
+        return false;
+    }
+    if (right && right->hdr.nkeys > BPT_INNER_MIN) {
+        n->keys[n->hdr.nkeys] = p->keys[c];
+        n->child[n->hdr.nkeys + 1] = right->child[0];
+        n->hdr.nkeys++;
+        p->keys[c] = right->keys[0];
+        memmove(right->child, &right->child[1],
+                sizeof(struct bpt_hdr *) * right->hdr.nkeys);
+        right->child[right->hdr.nkeys] = NULL;
+        /* drops keys[0], the child on its left is gone already */
+        right->hdr.nkeys--;
+        memmove(right->keys, &right->keys[1],
+                sizeof(int) * right->hdr.nkeys);
+        right->keys[right->hdr.nkeys] = INT_MAX;
+        return false;
+    }
+
+    if (left) {
+        right = n;
+        n = left;
+        c--;
+    }
+    n->keys[n->hdr.nkeys] = p->keys[c];
+    memcpy(&n->keys[n->hdr.nkeys + 1], right->keys,
+           sizeof(int) * right->hdr.nkeys);
+    memcpy(&n->child[n->hdr.nkeys + 1], right->child,
+           sizeof(struct bpt_hdr *) * (right->hdr.nkeys + 1));
+    n->hdr.nkeys += right->hdr.nkeys + 1;
+    bpt_inner_remove_at(p, c);
+    pool_free(&t->pool, right);
+    return true;
+}
+
+int bptree_remove(void *ctx, int a)
+{
+    struct bptree *t = (struct bptree *) ctx;
+    struct bpt_inner *path[BPT_MAX_DEPTH];
+    unsigned int idx[BPT_MAX_DEPTH];
+    struct bpt_hdr *n = t->root;
+    int depth = 0;
+
+    while (!n->leaf) {
+        unsigned int c = bpt_child(bpt_inner(n), a);
+        path[depth] = bpt_inner(n);
+        idx[depth++] = c;
+        n = bpt_inner(n)->child[c];
+    }
+
+    struct bpt_leaf *l = bpt_leaf(n);
+    unsigned int pos = bpt_rank(l->keys, BPT_LEAF_KEYS, a);
+    if (pos >= l->hdr.nkeys || l->keys[pos] != a)
+        return -1;
+
+    /* Separators equal to @a may stay: they still split the key space */
+    bpt_leaf_remove_at(l, pos);
+    t->count--;
+    if (l->hdr.nkeys >= BPT_LEAF_MIN || !depth)
+        return 0;
+
+    /* a merge may leave the parent short in turn, up to the root */
+    int d = depth - 1;
+    bool shrunk = bpt_fix_leaf(t, path[d], idx[d]);
+    while (shrunk && d > 0 && path[d]->hdr.nkeys < BPT_INNER_MIN) {
+        shrunk = bpt_fix_inner(t, path[d - 1], idx[d - 1]);
+        d--;
+    }
+
+    /* an inner root left with a single child gives its place up */
+    if (!t->root->leaf && !t->root->nkeys) {
+        struct bpt_inner *root = bpt_inner(t->root);
+        t->root = root->child[0];
+        pool_free(&t->pool, root);
+        t->height--;
+    }
+    return 0;
+}
+
+/* Load @n keys, sorted in ascending order without duplicates, into an empty
+ * tree, level by level from the leaves up. Nodes are filled evenly, as full
+ * as possible.
+ */
+int bptree_build(void *ctx, const int *keys, size_t n)
+{
+    struct bptree *t = (struct bptree *) ctx;
+    struct bpt_hdr **level;
+    int *mins;
+    size_t count;
+
+    if (!t->root->leaf || t->root->nkeys)
+        return -1;
+    for (size_t i = 1; i < n; i++) {
+        if (keys[i - 1] >= keys[i])
+            return -1;
+    }
+    if (!n)
+        return 0;
+
+    count = (n + BPT_LEAF_KEYS - 1) / BPT_LEAF_KEYS;
+    level = malloc(sizeof(struct bpt_hdr *) * count);
+    mins = malloc(sizeof(int) * count);
+    if (!level || !mins) {
+        free(level);
+        free(mins);
+        return -1;
+    }
+
+    /* the empty root leaf is reused as the first one */
+    struct bpt_leaf *prev = NULL;
+    for (size_t i = 0, k = 0; i < count; i++) {
+        struct bpt_leaf *l = i ? bpt_leaf_alloc(t) : t->head;
+        size_t cnt = n / count + (i < n % count);
+
+        memcpy(l->keys, &keys[k], sizeof(int) * cnt);
+        l->hdr.nkeys = cnt;
+        l->prev = prev;
+        if (prev)
+            prev->next = l;
+        prev = l;
+        level[i] = &l->hdr;
+        mins[i] = keys[k];
+        k += cnt;
+    }
+
+    while (count > 1) {
+        size_t parents = (count + BPT_INNER_KEYS) / (BPT_INNER_KEYS + 1);
+
+        for (size_t i = 0, k = 0; i < parents; i++) {
+            struct bpt_inner *p = bpt_inner_alloc(t);
+            size_t cnt = count / parents + (i < count % parents);
+
+            p->hdr.nkeys = cnt - 1;
+            for (size_t j = 0; j < cnt; j++) {
+                p->child[j] = level[k + j];
+                if (j)
+                    p->keys[j - 1] = mins[k + j];
+            }
+            level[i] = &p->hdr;
+            mins[i] = mins[k];
+            k += cnt;
+        }
+        count = parents;
+        t->height++;
+    }
+
+    t->root = level[0];
+    t->count = n;
+    free(level);
+    free(mins);
+    return 0;
+}
+
+int bptree_lower_bound(void *ctx, int a, int *out)
+{
+    struct bpt_leaf *l = bpt_find_leaf((struct bptree *) ctx, a);
+    unsigned int pos = bpt_rank(l->keys, BPT_LEAF_KEYS, a);
+
+    if (pos == l->hdr.nkeys) {
+        /* every key of the next leaf is larger than @a */
+        l = l->next;
+        pos = 0;
+    }
+    if (!l || !l->hdr.nkeys)
+        return -1;
+    *out = l->keys[pos];
+    return 0;
+}
+
+/* Count the keys in [lo, hi] by walking the leaf chain */
+size_t bptree_range(void *ctx, int lo, int hi)
+{
+    struct bpt_leaf *l = bpt_find_leaf((struct bptree *) ctx, lo);
+    unsigned int pos = bpt_rank(l->keys, BPT_LEAF_KEYS, lo);
+    size_t count = 0;
+
+    for (; l; l = l->next, pos = 0) {
+        for (; pos < l->hdr.nkeys; pos++) {
+            if (l->keys[pos] > hi)
+                return count;
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t bptree_size(void *ctx)
+{
+    return ((struct bptree *) ctx)->count;
+}
+
+size_t bptree_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    struct bptree *t = (struct bptree *) ctx;
+    size_t count = 0;
+
+    for (struct bpt_leaf *l = t->head; l; l = l->next) {
+        for (unsigned int i = 0; i < l->hdr.nkeys; i++)
+            cb(l->keys[i], arg);
+        count += l->hdr.nkeys;
+    }
+    return count;
+}
+
+/* Every key sits in a leaf, so they all have the depth of the tree */
+int bptree_height(void *ctx, double *avg_depth)
+{
+    struct bptree *t = (struct bptree *) ctx;
+
+    if (avg_depth)
+        *avg_depth = t->height;
+    return t->height;
+}
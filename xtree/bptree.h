@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+/* B+tree of integers. Nodes are BPT_NODE_SIZE bytes, a few cache lines, so
+ * that one miss brings in dozens of keys instead of one. The keys live in the
+ * leaves, which are linked in order for scans; inner nodes only hold
+ * separators. In-node search counts the keys below the target over the whole
+ * node, without branches; unused slots are padded with INT_MAX so the loop
+ * has a fixed trip count and the compiler can vectorize it.
+ */
+#define BPT_NODE_SIZE 256
+
+extern void *bptree_init();
+extern int bptree_destroy(void *ctx);
+extern int bptree_insert(void *ctx, int a);
+extern void *bptree_find(void *ctx, int a);
+extern int bptree_remove(void *ctx, int a);
+extern int bptree_build(void *ctx, const int *keys, size_t n);
+extern size_t bptree_range(void *ctx, int lo, int hi);
+extern int bptree_lower_bound(void *ctx, int a, int *out);
+extern size_t bptree_size(void *ctx);
+extern size_t bptree_iterate(void *ctx, void (*cb)(int, void *), void *arg);
+extern int bptree_height(void *ctx, double *avg_depth);
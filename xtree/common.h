@@ -1,8 +1,33 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 #define container_of(ptr, type, member) \
     ((type *) ((char *) (ptr) - (offsetof(type, member))))
 
-#define __unused __attribute__((unused))
\ No newline at end of file
+#define __unused __attribute__((unused))
+
+/* Single accesses to a location shared with lock-free readers, which the
+ * compiler may not tear, merge or repeat. They are relaxed atomics and
+ * compile to plain loads and stores.
+ */
+#define READ_ONCE(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define WRITE_ONCE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+/* Three-way comparison returning -1, 0 or 1. Unlike a - b it cannot
+ * overflow, and it compiles to flag-setting instructions, without branches.
+ */
+static inline int cmp_int(int a, int b)
+{
+    return (a > b) - (a < b);
+}
+
+static inline int cmp_int64(int64_t a, int64_t b)
+{
+    return (a > b) - (a < b);
+}
+
+#ifndef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#endif
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "eytzinger.h"
+
+/* keys per cache line: the descendants of k four levels down are the
+ * EYT_LINE slots starting at k * EYT_LINE
+ */
+#define EYT_LINE (64 / sizeof(int))
+
+/* In-order walk of the implicit tree, without recursion */
+static inline size_t eyt_first(size_t n)
+{
+    size_t k = 1;
+
+    while (2 * k <= n)
+        k *= 2;
+    return k;
+}
+
+static inline size_t eyt_next(size_t k, size_t n)
+{
+    if (2 * k + 1 <= n) {
+        /* leftmost slot of the right subtree */
+        k = 2 * k + 1;
+        while (2 * k <= n)
+            k *= 2;
+        return k;
+    }
+    /* climb while we are a right child, then once more */
+    while (k & 1)
+        k >>= 1;
+    return k >> 1;
+}
+
+/* Build a snapshot of @n keys sorted in ascending order without duplicates */
+struct eyt_set *eyt_create(const int *sorted, size_t n)
+{
+    struct eyt_set *s = malloc(sizeof(struct eyt_set));
+    size_t size = (sizeof(int) * (n + 1) + 63) & ~(size_t) 63;
+
+    if (!s)
+        return NULL;
+    s->n = n;
+    s->keys = aligned_alloc(64, size);
+    if (!s->keys) {
+        free(s);
+        return NULL;
+    }
+    memset(s->keys, 0, size);
+    for (size_t i = 0, k = eyt_first(n); i < n; i++, k = eyt_next(k, n))
+        s->keys[k] = sorted[i];
+    return s;
+}
+
+int eyt_destroy(void *ctx)
+{
+    struct eyt_set *s = (struct eyt_set *) ctx;
+
+    free(s->keys);
+    free(s);
+    return 0;
+}
+
+/* Slot of the smallest key not less than @a, 0 if there is none. The
+ * descent always runs to the bottom; the path taken is encoded in the bits of
+ * k, and the last left turn is the answer.
+ */
+static inline size_t eyt_search(const struct eyt_set *s, int a)
+{
+    const int *keys = s->keys;
+    size_t k = 1;
+
+    while (k <= s->n) {
+        __builtin_prefetch(keys + k * EYT_LINE);
+        k = 2 * k + (keys[k] < a);
+    }
+    return k >> __builtin_ffsll(~k);
+}
+
+void *eyt_find(void *ctx, int a)
+{
+    struct eyt_set *s = (struct eyt_set *) ctx;
+    size_t k = eyt_search(s, a);
+
+    return k && s->keys[k] == a ? &s->keys[k] : NULL;
+}
+
+int eyt_lower_bound(void *ctx, int a, int *out)
+{
+    struct eyt_set *s = (struct eyt_set *) ctx;
+    size_t k = eyt_search(s, a);
+
+    if (!k)
+        return -1;
+    *out = s->keys[k];
+    return 0;
+}
+
+size_t eyt_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    struct eyt_set *s = (struct eyt_set *) ctx;
+
+    for (size_t i = 0, k = eyt_first(s->n); i < s->n;
+         i++, k = eyt_next(k, s->n))
+        cb(s->keys[k], arg);
+    return s->n;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+
+/* Read-only snapshot of an integer set in Eytzinger (BFS) order: the
+ * implicit binary tree rooted at keys[1], with the children of keys[k] at
+ * keys[2k] and keys[2k + 1]. No pointers are stored, the top levels share a
+ * few cache lines, and a lookup is a branch-free descent that prefetches the
+ * line holding the descendants four levels down.
+ */
+struct eyt_set {
+    size_t n;
+    int *keys; /* n + 1 slots, keys[0] unused, cache line aligned */
+};
+
+struct eyt_set *eyt_create(const int *sorted, size_t n);
+int eyt_destroy(void *ctx);
+void *eyt_find(void *ctx, int a);
+int eyt_lower_bound(void *ctx, int a, int *out);
+size_t eyt_iterate(void *ctx, void (*cb)(int, void *), void *arg);
@@ -0,0 +1,184 @@
+#include <stdbool.h>
+
+#include "interval_tree.h"
+
+#define itree_entry(n) rb_entry(n, struct interval_node, rb)
+
+static inline int itree_compute_last(struct interval_node *node)
+{
+    int max = node->last;
+
+    if (node->rb.rb_left) {
+        int l = itree_entry(node->rb.rb_left)->subtree_last;
+        if (l > max)
+            max = l;
+    }
+    if (node->rb.rb_right) {
+        int r = itree_entry(node->rb.rb_right)->subtree_last;
+        if (r > max)
+            max = r;
+    }
+    return max;
+}
+
+/* Augment callbacks maintaining subtree_last */
+static void itree_propagate(struct rb_node *rb, struct rb_node *stop)
+{
+    while (rb != stop) {
+        struct interval_node *node = itree_entry(rb);
+        int last = itree_compute_last(node);
+
+        if (node->subtree_last == last)
+            break;
+        node->subtree_last = last;
+        rb = rb_parent(rb);
+    }
+}
+
+static void itree_copy(struct rb_node *old, struct rb_node *new)
+{
+    itree_entry(new)->subtree_last = itree_entry(old)->subtree_last;
+}
+
+static void itree_rotate(struct rb_node *old, struct rb_node *new)
+{
+    struct interval_node *o = itree_entry(old);
+
+    itree_entry(new)->subtree_last = o->subtree_last;
+    o->subtree_last = itree_compute_last(o);
+}
+
+static const struct rb_augment_callbacks itree_callbacks = {
+    .propagate = itree_propagate,
+    .copy = itree_copy,
+    .rotate = itree_rotate,
+};
+
+void interval_tree_init(struct interval_tree *tree)
+{
+    tree->root = RB_ROOT;
+    tree->count = 0;
+}
+
+void interval_tree_insert(struct interval_tree *tree,
+                          struct interval_node *node)
+{
+    struct rb_node **link = &tree->root.rb_node, *parent = NULL;
+
+    /* subtree_last only grows along the path down to the new leaf */
+    while (*link) {
+        struct interval_node *p = itree_entry(*link);
+
+        parent = *link;
+        if (p->subtree_last < node->last)
+            p->subtree_last = node->last;
+        if (node->start < p->start)
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    node->subtree_last = node->last;
+    rb_link_node(&node->rb, parent, link);
+    rb_insert_augmented(&node->rb, &tree->root, &itree_callbacks);
+    tree->count++;
+}
+
+void interval_tree_remove(struct interval_tree *tree,
+                          struct interval_node *node)
+{
+    rb_erase_augmented(&node->rb, &tree->root, &itree_callbacks);
+    tree->count--;
+}
+
+/* Leftmost interval of the subtree under @node overlapping [start, last],
+ * knowing that node->subtree_last >= start.
+ */
+static struct interval_node *itree_subtree_search(struct interval_node *node,
+                                                  int start,
+                                                  int last)
+{
+    while (true) {
+        /* Everything on the left starts no later than @node, so an overlap
+         * there comes first.
+         */
+        if (node->rb.rb_left) {
+            struct interval_node *left = itree_entry(node->rb.rb_left);
+            if (start <= left->subtree_last) {
+                node = left;
+                continue;
+            }
+        }
+        if (node->start > last) /* everything further right starts later */
+            return NULL;
+        if (start <= node->last)
+            return node;
+        if (!node->rb.rb_right)
+            return NULL;
+        node = itree_entry(node->rb.rb_right);
+        if (start > node->subtree_last)
+            return NULL;
+    }
+}
+
+struct interval_node *interval_tree_iter_first(struct interval_tree *tree,
+                                               int start,
+                                               int last)
+{
+    struct interval_node *node;
+
+    if (!tree->root.rb_node)
+        return NULL;
+    node = itree_entry(tree->root.rb_node);
+    if (node->subtree_last < start)
+        return NULL;
+    return itree_subtree_search(node, start, last);
+}
+
+struct interval_node *interval_tree_iter_next(struct interval_node *node,
+                                              int start,
+                                              int last)
+{
+    struct rb_node *rb = node->rb.rb_right, *prev;
+
+    while (true) {
+        /* Overlaps in the right subtree come before the ancestors */
+        if (rb) {
+            struct interval_node *right = itree_entry(rb);
+            if (start <= right->subtree_last)
+                return itree_subtree_search(right, start, last);
+        }
+
+        /* Climb to the first ancestor we are on the left of */
+        do {
+            rb = rb_parent(&node->rb);
+            if (!rb)
+                return NULL;
+            prev = &node->rb;
+            node = itree_entry(rb);
+            rb = node->rb.rb_right;
+        } while (prev == rb);
+
+        if (last < node->start)
+            return NULL;
+        if (start <= node->last)
+            return node;
+    }
+}
+
+size_t interval_tree_overlap(struct interval_tree *tree,
+                             int start,
+                             int last,
+                             void (*cb)(struct interval_node *, void *),
+                             void *arg)
+{
+    size_t count = 0;
+
+    for (struct interval_node *n = interval_tree_iter_first(tree, start, last);
+         n; n = interval_tree_iter_next(n, start, last)) {
+        if (cb)
+            cb(n, arg);
+        count++;
+    }
+    return count;
+}
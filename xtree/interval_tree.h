@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+/* Interval tree over closed integer intervals [start, last], built on the
+ * augmented red-black tree: nodes are ordered by start and each one caches
+ * the largest last of its subtree, so that subtrees lying entirely before a
+ * query are skipped. Identical intervals may be stored more than once.
+ */
+struct interval_node {
+    struct rb_node rb;
+    int start, last;
+    int subtree_last;
+};
+
+struct interval_tree {
+    struct rb_root root;
+    size_t count;
+};
+
+extern void interval_tree_init(struct interval_tree *tree);
+extern void interval_tree_insert(struct interval_tree *tree,
+                                 struct interval_node *node);
+extern void interval_tree_remove(struct interval_tree *tree,
+                                 struct interval_node *node);
+
+/* Iterate over the intervals overlapping [start, last], in ascending order of
+ * their start:
+ *
+ *     for (n = interval_tree_iter_first(tree, start, last); n;
+ *          n = interval_tree_iter_next(n, start, last))
+ */
+extern struct interval_node *interval_tree_iter_first(
+    struct interval_tree *tree,
+    int start,
+    int last);
+extern struct interval_node *interval_tree_iter_next(struct interval_node *node,
+                                                     int start,
+                                                     int last);
+
+/* Call @cb on every interval overlapping [start, last] and return how many
+ * there are. A stabbing query is interval_tree_overlap(tree, p, p, ...).
+ */
+extern size_t interval_tree_overlap(struct interval_tree *tree,
+                                    int start,
+                                    int last,
+                                    void (*cb)(struct interval_node *, void *),
+                                    void *arg);
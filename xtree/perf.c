@@ -0,0 +1,126 @@
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf.h"
+
+#define PERF_CACHE(cache, op, result)                                  \
+    (PERF_COUNT_HW_CACHE_##cache | (PERF_COUNT_HW_CACHE_OP_##op << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_##result << 16))
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} perf_events[PERF_NR_EVENTS] = {
+    [PERF_CYCLES] = {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [PERF_INSTRUCTIONS] = {"instructions", PERF_TYPE_HARDWARE,
+                           PERF_COUNT_HW_INSTRUCTIONS},
+    [PERF_L1D_MISSES] = {"L1d misses", PERF_TYPE_HW_CACHE,
+                         PERF_CACHE(L1D, READ, MISS)},
+    [PERF_LLC_MISSES] = {"LLC misses", PERF_TYPE_HARDWARE,
+                         PERF_COUNT_HW_CACHE_MISSES},
+    [PERF_BRANCH_MISSES] = {"branch misses", PERF_TYPE_HARDWARE,
+                            PERF_COUNT_HW_BRANCH_MISSES},
+    [PERF_DTLB_MISSES] = {"dTLB misses", PERF_TYPE_HW_CACHE,
+                          PERF_CACHE(DTLB, READ, MISS)},
+};
+
+const char *perf_event_name(enum perf_event e)
+{
+    return perf_events[e].name;
+}
+
+/* Returns the number of events opened, 0 when none is available */
+int perf_open(struct perf_counters *pc)
+{
+    int opened = 0;
+
+    for (int i = 0; i < PERF_NR_EVENTS; i++) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_events[i].type;
+        attr.config = perf_events[i].config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        pc->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        opened += pc->fd[i] >= 0;
+    }
+    return opened;
+}
+
+void perf_close(struct perf_counters *pc)
+{
+    for (int i = 0; i < PERF_NR_EVENTS; i++) {
+        if (pc->fd[i] >= 0)
+            close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+}
+
+static void perf_ioctl(struct perf_counters *pc, unsigned long req)
+{
+    for (int i = 0; i < PERF_NR_EVENTS; i++) {
+        if (pc->fd[i] >= 0)
+            ioctl(pc->fd[i], req, 0);
+    }
+}
+
+void perf_pause(struct perf_counters *pc)
+{
+    perf_ioctl(pc, PERF_EVENT_IOC_DISABLE);
+}
+
+void perf_resume(struct perf_counters *pc)
+{
+    perf_ioctl(pc, PERF_EVENT_IOC_ENABLE);
+}
+
+/* value, time enabled, time running */
+static bool perf_read(int fd, uint64_t v[3])
+{
+    ssize_t len = sizeof(uint64_t) * 3;
+
+    return fd >= 0 && read(fd, v, len) == len;
+}
+
+/* PERF_EVENT_IOC_RESET only clears the count, not the enabled and running
+ * times, so a phase is measured as the difference from a snapshot instead.
+ */
+void perf_start(struct perf_counters *pc)
+{
+    for (int i = 0; i < PERF_NR_EVENTS; i++) {
+        if (!perf_read(pc->fd[i], pc->base[i]))
+            memset(pc->base[i], 0, sizeof(pc->base[i]));
+    }
+    perf_ioctl(pc, PERF_EVENT_IOC_ENABLE);
+}
+
+/* Stop counting and read the counts since perf_start(), scaled by the share
+ * of that interval each event spent on the PMU.
+ */
+void perf_stop(struct perf_counters *pc, struct perf_sample *s)
+{
+    perf_pause(pc);
+
+    for (int i = 0; i < PERF_NR_EVENTS; i++) {
+        uint64_t v[3], value = 0, enabled = 0, running = 0;
+
+        if (perf_read(pc->fd[i], v)) {
+            value = v[0] - pc->base[i][0];
+            enabled = v[1] - pc->base[i][1];
+            running = v[2] - pc->base[i][2];
+        }
+        s->valid[i] = running != 0;
+        s->value[i] = running ? (double) value * enabled / running : 0;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Hardware counters of the calling thread, and of the threads it creates
+ * while they are enabled, through perf_event_open(2). User space only, so
+ * that perf_event_paranoid up to 2 lets an unprivileged process count.
+ *
+ * Every event is opened on its own: a PMU lacking one of them (virtual
+ * machines often expose none) leaves that counter unavailable instead of
+ * failing the whole set. When the kernel multiplexes more events than the
+ * PMU has slots, values are scaled by the share of time each one ran
+ * between perf_start() and perf_stop().
+ */
+enum perf_event {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_NR_EVENTS,
+};
+
+struct perf_counters {
+    int fd[PERF_NR_EVENTS]; /* -1: not available */
+    uint64_t base[PERF_NR_EVENTS][3]; /* read at perf_start() */
+};
+
+struct perf_sample {
+    double value[PERF_NR_EVENTS];
+    bool valid[PERF_NR_EVENTS];
+};
+
+int perf_open(struct perf_counters *pc);
+void perf_close(struct perf_counters *pc);
+void perf_start(struct perf_counters *pc);
+void perf_pause(struct perf_counters *pc);
+void perf_resume(struct perf_counters *pc);
+void perf_stop(struct perf_counters *pc, struct perf_sample *s);
+const char *perf_event_name(enum perf_event e);
@@ -0,0 +1,82 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+#define POOL_ALIGN sizeof(void *)
+/* Chunks start on a cache line, so that objects whose size is a multiple of
+ * it do not straddle one more line than they need.
+ */
+#define POOL_CHUNK_ALIGN 64
+
+struct pool_chunk {
+    struct pool_chunk *next;
+    char data[] __attribute__((aligned(POOL_CHUNK_ALIGN)));
+};
+
+int pool_init(struct node_pool *pool, size_t obj_size, size_t chunk_objs)
+{
+    assert(pool && chunk_objs);
+
+    /* every slot must be able to hold the free list link */
+    if (obj_size < sizeof(void *))
+        obj_size = sizeof(void *);
+    obj_size = (obj_size + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+
+    pool->obj_size = obj_size;
+    pool->chunk_objs = chunk_objs;
+    /* force a chunk allocation on first use */
+    pool->used = chunk_objs;
+    pool->free_list = NULL;
+    pool->chunks = NULL;
+    return 0;
+}
+
+void pool_destroy(struct node_pool *pool)
+{
+    struct pool_chunk *c = pool->chunks;
+    while (c) {
+        struct pool_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+
+    pool->chunks = NULL;
+    pool->free_list = NULL;
+    pool->used = pool->chunk_objs;
+}
+
+/* Objects are returned zero-filled, matching the calloc() calls they replace */
+void *pool_alloc(struct node_pool *pool)
+{
+    void *obj;
+
+    if (pool->free_list) {
+        obj = pool->free_list;
+        pool->free_list = *(void **) obj;
+    } else {
+        if (pool->used == pool->chunk_objs) {
+            size_t size = sizeof(struct pool_chunk) +
+                          pool->obj_size * pool->chunk_objs;
+            struct pool_chunk *c = aligned_alloc(
+                POOL_CHUNK_ALIGN,
+                (size + POOL_CHUNK_ALIGN - 1) & ~(POOL_CHUNK_ALIGN - 1));
+            if (!c)
+                return NULL;
+            c->next = pool->chunks;
+            pool->chunks = c;
+            pool->used = 0;
+        }
+        obj = pool->chunks->data + pool->obj_size * pool->used++;
+    }
+
+    memset(obj, 0, pool->obj_size);
+    return obj;
+}
+
+void pool_free(struct node_pool *pool, void *obj)
+{
+    *(void **) obj = pool->free_list;
+    pool->free_list = obj;
+}
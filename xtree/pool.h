@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+/* A fixed-size object pool backing the tree adapters.
+ *
+ * Objects are carved out of large chunks obtained from malloc, and released
+ * objects are kept on an intrusive free list for reuse. Nothing is returned to
+ * the system until pool_destroy(), which drops every chunk at once, so tearing
+ * down a tree does not need to visit its nodes.
+ */
+struct pool_chunk;
+
+struct node_pool {
+    size_t obj_size;
+    size_t chunk_objs;
+    size_t used;  /* objects handed out from the current chunk */
+    void *free_list;
+    struct pool_chunk *chunks;
+};
+
+int pool_init(struct node_pool *pool, size_t obj_size, size_t chunk_objs);
+void pool_destroy(struct node_pool *pool);
+void *pool_alloc(struct node_pool *pool);
+void pool_free(struct node_pool *pool, void *obj);
+
+/* number of tree nodes carved out of each pool chunk */
+#define TREEINT_POOL_CHUNK 4096
@@ -22,6 +22,10 @@ static inline void rb_set_parent_color(struct rb_node *rb,
     rb->__rb_parent_color = (unsigned long) p + color;
 }
 
+/* The lock-free readers of rbtree_rcu_find() follow child and root links
+ * without the lock, so insertion, rotations and erasure store those with
+ * WRITE_ONCE(), as the kernel does.
+ */
 static inline void __rb_change_child(struct rb_node *old,
                                      struct rb_node *new,
                                      struct rb_node *parent,
@@ -29,11 +33,11 @@ static inline void __rb_change_child(struct rb_node *old,
 {
     if (parent) {
         if (parent->rb_left == old)
-            parent->rb_left = new;
+            WRITE_ONCE(parent->rb_left, new);
         else
-            parent->rb_right = new;
+            WRITE_ONCE(parent->rb_right, new);
     } else
-        root->rb_node = new;
+        WRITE_ONCE(root->rb_node, new);
 }
 
 /*
@@ -58,8 +62,11 @@ static __always_inline void __rb_insert(
     void (*augment_rotate)(struct rb_node *old, struct rb_node *new))
 {
     struct rb_node *parent = rb_red_parent(node), *gparent, *tmp;
+    unsigned int steps = 0;
 
+    tree_stat_inc(rebalances);
     while (true) {
+        tree_stat_step(steps);
         /*
          * Loop invariant: node is red.
          */
@@ -124,12 +131,13 @@ static __always_inline void __rb_insert(
                  * continuation into Case 3 will fix that.
                  */
                 tmp = node->rb_left;
-                parent->rb_right = tmp;
-                node->rb_left = parent;
+                WRITE_ONCE(parent->rb_right, tmp);
+                WRITE_ONCE(node->rb_left, parent);
                 if (tmp)
                     rb_set_parent_color(tmp, parent, RB_BLACK);
                 rb_set_parent_color(parent, node, RB_RED);
                 augment_rotate(parent, node);
+                tree_stat_inc(rotations);
                 parent = node;
                 tmp = node->rb_right;
             }
@@ -144,12 +152,13 @@ static __always_inline void __rb_insert(
              *     /                 \
              *    n                   U
              */
-            gparent->rb_left = tmp; /* == parent->rb_right */
-            parent->rb_right = gparent;
+            WRITE_ONCE(gparent->rb_left, tmp); /* == parent->rb_right */
+            WRITE_ONCE(parent->rb_right, gparent);
             if (tmp)
                 rb_set_parent_color(tmp, gparent, RB_BLACK);
             __rb_rotate_set_parents(gparent, parent, root, RB_RED);
             augment_rotate(gparent, parent);
+            tree_stat_inc(rotations);
             break;
         } else {
             tmp = gparent->rb_left;
@@ -167,23 +176,25 @@ static __always_inline void __rb_insert(
             if (node == tmp) {
                 /* Case 2 - right rotate at parent */
                 tmp = node->rb_right;
-                parent->rb_left = tmp;
-                node->rb_right = parent;
+                WRITE_ONCE(parent->rb_left, tmp);
+                WRITE_ONCE(node->rb_right, parent);
                 if (tmp)
                     rb_set_parent_color(tmp, parent, RB_BLACK);
                 rb_set_parent_color(parent, node, RB_RED);
                 augment_rotate(parent, node);
+                tree_stat_inc(rotations);
                 parent = node;
                 tmp = node->rb_left;
             }
 
             /* Case 3 - left rotate at gparent */
-            gparent->rb_right = tmp; /* == parent->rb_left */
-            parent->rb_left = gparent;
+            WRITE_ONCE(gparent->rb_right, tmp); /* == parent->rb_left */
+            WRITE_ONCE(parent->rb_left, gparent);
             if (tmp)
                 rb_set_parent_color(tmp, gparent, RB_BLACK);
             __rb_rotate_set_parents(gparent, parent, root, RB_RED);
             augment_rotate(gparent, parent);
+            tree_stat_inc(rotations);
             break;
         }
     }
@@ -223,8 +234,11 @@ static __always_inline void ____rb_erase_color(
     void (*augment_rotate)(struct rb_node *old, struct rb_node *new))
 {
     struct rb_node *node = NULL, *sibling, *tmp1, *tmp2;
+    unsigned int steps = 0;
 
+    tree_stat_inc(rebalances);
     while (true) {
+        tree_stat_step(steps);
         /*
          * Loop invariants:
          * - node is black (or NULL on first iteration)
@@ -245,11 +259,12 @@ static __always_inline void ____rb_erase_color(
                  *     Sl  Sr      N   Sl
                  */
                 tmp1 = sibling->rb_left;
-                parent->rb_right = tmp1;
-                sibling->rb_left = parent;
+                WRITE_ONCE(parent->rb_right, tmp1);
+                WRITE_ONCE(sibling->rb_left, parent);
                 rb_set_parent_color(tmp1, parent, RB_BLACK);
                 __rb_rotate_set_parents(parent, sibling, root, RB_RED);
                 augment_rotate(parent, sibling);
+                tree_stat_inc(rotations);
                 sibling = tmp1;
             }
             tmp1 = sibling->rb_right;
@@ -310,12 +325,13 @@ static __always_inline void ____rb_erase_color(
                  *          Sr
                  */
                 tmp1 = tmp2->rb_right;
-                sibling->rb_left = tmp1;
-                tmp2->rb_right = sibling;
-                parent->rb_right = tmp2;
+                WRITE_ONCE(sibling->rb_left, tmp1);
+                WRITE_ONCE(tmp2->rb_right, sibling);
+                WRITE_ONCE(parent->rb_right, tmp2);
                 if (tmp1)
                     rb_set_parent_color(tmp1, sibling, RB_BLACK);
                 augment_rotate(sibling, tmp2);
+                tree_stat_inc(rotations);
                 tmp1 = sibling;
                 sibling = tmp2;
             }
@@ -332,24 +348,26 @@ static __always_inline void ____rb_erase_color(
              *      (sl) sr      N  (sl)
              */
             tmp2 = sibling->rb_left;
-            parent->rb_right = tmp2;
-            sibling->rb_left = parent;
+            WRITE_ONCE(parent->rb_right, tmp2);
+            WRITE_ONCE(sibling->rb_left, parent);
             rb_set_parent_color(tmp1, sibling, RB_BLACK);
             if (tmp2)
                 rb_set_parent(tmp2, parent);
             __rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
             augment_rotate(parent, sibling);
+            tree_stat_inc(rotations);
             break;
         } else {
             sibling = parent->rb_left;
             if (rb_is_red(sibling)) {
                 /* Case 1 - right rotate at parent */
                 tmp1 = sibling->rb_right;
-                parent->rb_left = tmp1;
-                sibling->rb_right = parent;
+                WRITE_ONCE(parent->rb_left, tmp1);
+                WRITE_ONCE(sibling->rb_right, parent);
                 rb_set_parent_color(tmp1, parent, RB_BLACK);
                 __rb_rotate_set_parents(parent, sibling, root, RB_RED);
                 augment_rotate(parent, sibling);
+                tree_stat_inc(rotations);
                 sibling = tmp1;
             }
             tmp1 = sibling->rb_left;
@@ -370,24 +388,26 @@ static __always_inline void ____rb_erase_color(
                 }
                 /* Case 3 - left rotate at sibling */
                 tmp1 = tmp2->rb_left;
-                sibling->rb_right = tmp1;
-                tmp2->rb_left = sibling;
-                parent->rb_left = tmp2;
+                WRITE_ONCE(sibling->rb_right, tmp1);
+                WRITE_ONCE(tmp2->rb_left, sibling);
+                WRITE_ONCE(parent->rb_left, tmp2);
                 if (tmp1)
                     rb_set_parent_color(tmp1, sibling, RB_BLACK);
                 augment_rotate(sibling, tmp2);
+                tree_stat_inc(rotations);
                 tmp1 = sibling;
                 sibling = tmp2;
             }
             /* Case 4 - right rotate at parent + color flips */
             tmp2 = sibling->rb_right;
-            parent->rb_left = tmp2;
-            sibling->rb_right = parent;
+            WRITE_ONCE(parent->rb_left, tmp2);
+            WRITE_ONCE(sibling->rb_right, parent);
             rb_set_parent_color(tmp1, sibling, RB_BLACK);
             if (tmp2)
                 rb_set_parent(tmp2, parent);
             __rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
             augment_rotate(parent, sibling);
+            tree_stat_inc(rotations);
             break;
         }
     }
@@ -474,8 +494,8 @@ static __always_inline struct rb_node *__rb_erase_augmented(
                 tmp = tmp->rb_left;
             } while (tmp);
             child2 = successor->rb_right;
-            parent->rb_left = child2;
-            successor->rb_right = child;
+            WRITE_ONCE(parent->rb_left, child2);
+            WRITE_ONCE(successor->rb_right, child);
             rb_set_parent(child, successor);
 
             augment->copy(node, successor);
@@ -483,7 +503,7 @@ static __always_inline struct rb_node *__rb_erase_augmented(
         }
 
         tmp = node->rb_left;
-        successor->rb_left = tmp;
+        WRITE_ONCE(successor->rb_left, tmp);
         rb_set_parent(tmp, successor);
 
         pc = node->__rb_parent_color;
@@ -511,3 +531,185 @@ void rb_erase(struct rb_node *node, struct rb_root *root)
     if (rebalance)
         ____rb_erase_color(rebalance, root, dummy_rotate);
 }
+
+/*
+ * Augmented rbtree manipulation functions.
+ *
+ * The caller links @node and updates the augmented data on the path from the
+ * root down to it before rb_insert_augmented(); the callbacks take care of the
+ * rotations. rb_erase_augmented() calls them for every node whose subtree
+ * changes.
+ */
+
+void rb_insert_augmented(struct rb_node *node,
+                         struct rb_root *root,
+                         const struct rb_augment_callbacks *augment)
+{
+    __rb_insert(node, root, augment->rotate);
+}
+
+void rb_erase_augmented(struct rb_node *node,
+                        struct rb_root *root,
+                        const struct rb_augment_callbacks *augment)
+{
+    struct rb_node *rebalance = __rb_erase_augmented(node, root, augment);
+    if (rebalance)
+        __rb_erase_color(rebalance, root, augment->rotate);
+}
+
+static struct rb_node *__rb_build(struct rb_node **nodes,
+                                  size_t lo,
+                                  size_t hi,
+                                  struct rb_node *parent,
+                                  unsigned int depth,
+                                  unsigned int red_depth)
+{
+    if (lo == hi)
+        return NULL;
+
+    size_t mid = lo + (hi - lo) / 2;
+    struct rb_node *node = nodes[mid];
+
+    rb_set_parent_color(node, parent, depth == red_depth ? RB_RED : RB_BLACK);
+    node->rb_left = __rb_build(nodes, lo, mid, node, depth + 1, red_depth);
+    node->rb_right = __rb_build(nodes, mid + 1, hi, node, depth + 1, red_depth);
+    return node;
+}
+
+/*
+ * Build a tree out of @n nodes sorted in ascending order, in O(n) and without
+ * any rotation. Splitting at the median keeps every leaf on the last two
+ * levels, so painting the deepest level red and everything above it black
+ * gives the same black height on every path. The tree must be empty.
+ */
+int rb_build_sorted(struct rb_root *root, struct rb_node **nodes, size_t n)
+{
+    unsigned int red_depth = 0;
+
+    if (root->rb_node)
+        return -1;
+
+    /* deepest level is floor(log2(n)); keep a lone root black */
+    for (size_t i = n; i > 1; i >>= 1)
+        red_depth++;
+    if (!red_depth)
+        red_depth = ~0U;
+
+    root->rb_node = __rb_build(nodes, 0, n, NULL, 0, red_depth);
+    return 0;
+}
+
+/*
+ * This function returns the first node (in sort order) of the tree.
+ */
+struct rb_node *rb_first(const struct rb_root *root)
+{
+    struct rb_node *n = root->rb_node;
+
+    if (!n)
+        return NULL;
+    while (n->rb_left)
+        n = n->rb_left;
+    return n;
+}
+
+struct rb_node *rb_next(const struct rb_node *node)
+{
+    struct rb_node *parent;
+
+    if (RB_EMPTY_NODE(node))
+        return NULL;
+
+    /*
+     * If we have a right-hand child, go down and then left as far
+     * as we can.
+     */
+    if (node->rb_right) {
+        node = node->rb_right;
+        while (node->rb_left)
+            node = node->rb_left;
+        return (struct rb_node *) node;
+    }
+
+    /*
+     * No right-hand children. Everything down and left is smaller than us,
+     * so any 'next' node must be in the general direction of our parent.
+     * Go up the tree; any time the ancestor is a right-hand child of its
+     * parent, keep going up. First time it's a left-hand child of its
+     * parent, said parent is our 'next' node.
+     */
+    while ((parent = rb_parent(node)) && node == parent->rb_right)
+        node = parent;
+
+    return parent;
+}
+
+struct rb_node *rb_last(const struct rb_root *root)
+{
+    struct rb_node *n = root->rb_node;
+
+    if (!n)
+        return NULL;
+    while (n->rb_right)
+        n = n->rb_right;
+    return n;
+}
+
+struct rb_node *rb_prev(const struct rb_node *node)
+{
+    struct rb_node *parent;
+
+    if (RB_EMPTY_NODE(node))
+        return NULL;
+
+    /*
+     * If we have a left-hand child, go down and then right as far
+     * as we can.
+     */
+    if (node->rb_left) {
+        node = node->rb_left;
+        while (node->rb_right)
+            node = node->rb_right;
+        return (struct rb_node *) node;
+    }
+
+    /*
+     * No left-hand children. Go up till we find an ancestor which
+     * is a right-hand child of its parent.
+     */
+    while ((parent = rb_parent(node)) && node == parent->rb_left)
+        node = parent;
+
+    return parent;
+}
+
+/* Depth histogram and height of the tree, through an in-order walk along
+ * the parent links that tracks the depth of the current node.
+ */
+void rb_stats(const struct rb_root *root, struct tree_shape *s)
+{
+    const struct rb_node *n = root->rb_node;
+    unsigned int depth = 1;
+
+    tree_shape_init(s);
+    for (; n && n->rb_left; depth++)
+        n = n->rb_left;
+
+    while (n) {
+        tree_shape_add(s, depth);
+        if (n->rb_right) {
+            n = n->rb_right;
+            for (depth++; n->rb_left; depth++)
+                n = n->rb_left;
+            continue;
+        }
+
+        const struct rb_node *p = rb_parent(n);
+        for (depth--; p && p->rb_right == n; depth--) {
+            n = p;
+            p = rb_parent(p);
+        }
+        n = p;
+    }
+    tree_shape_done(s);
+}
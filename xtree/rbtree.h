@@ -1,6 +1,9 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "common.h"
+#include "stats.h"
 
 struct rb_node {
     unsigned long __rb_parent_color;
@@ -12,6 +15,21 @@ struct rb_root {
     struct rb_node *rb_node;
 };
 
+/*
+ * Leftmost and rightmost-cached rbtrees.
+ *
+ * We do not cache the minimum and maximum nodes of the tree in struct
+ * rb_root; walking down the left or right spine costs O(log n). Users that
+ * frequently need them, e.g. priority queues, use struct rb_root_cached
+ * instead, which keeps both pointers up to date through
+ * rb_insert_color_cached() and rb_erase_cached() in O(1) extra time.
+ */
+struct rb_root_cached {
+    struct rb_root rb_root;
+    struct rb_node *rb_leftmost;
+    struct rb_node *rb_rightmost;
+};
+
 /*
  * Please note - only struct rb_augment_callbacks and the prototypes for
  * rb_insert_augmented() and rb_erase_augmented() are intended to be public.
@@ -44,6 +62,17 @@ struct rb_augment_callbacks {
         NULL,        \
     }
 
+#define RB_ROOT_CACHED          \
+    (struct rb_root_cached) \
+    {                       \
+        {NULL}, NULL, NULL  \
+    }
+
+/* Same as rb_first(), but O(1) */
+#define rb_first_cached(root) (root)->rb_leftmost
+/* Same as rb_last(), but O(1) */
+#define rb_last_cached(root) (root)->rb_rightmost
+
 #define rb_entry(ptr, type, member) container_of(ptr, type, member)
 
 #define rb_parent(r) ((struct rb_node *) ((r)->__rb_parent_color & ~3))
@@ -62,6 +91,20 @@ static inline void rb_set_parent(struct rb_node *rb, struct rb_node *p)
 
 extern void rb_insert_color(struct rb_node *, struct rb_root *);
 extern void rb_erase(struct rb_node *, struct rb_root *);
+extern void rb_insert_augmented(struct rb_node *node,
+                                struct rb_root *root,
+                                const struct rb_augment_callbacks *augment);
+extern void rb_erase_augmented(struct rb_node *node,
+                               struct rb_root *root,
+                               const struct rb_augment_callbacks *augment);
+extern struct rb_node *rb_first(const struct rb_root *root);
+extern struct rb_node *rb_next(const struct rb_node *node);
+extern struct rb_node *rb_last(const struct rb_root *root);
+extern struct rb_node *rb_prev(const struct rb_node *node);
+extern int rb_build_sorted(struct rb_root *root,
+                           struct rb_node **nodes,
+                           size_t n);
+extern void rb_stats(const struct rb_root *root, struct tree_shape *s);
 
 static inline void rb_link_node(struct rb_node *node,
                                 struct rb_node *parent,
@@ -70,7 +113,29 @@ static inline void rb_link_node(struct rb_node *node,
     node->__rb_parent_color = (unsigned long) parent;
     node->rb_left = node->rb_right = NULL;
 
-    *rb_link = node;
+    WRITE_ONCE(*rb_link, node);
+}
+
+static inline void rb_insert_color_cached(struct rb_node *node,
+                                          struct rb_root_cached *root,
+                                          bool leftmost,
+                                          bool rightmost)
+{
+    if (leftmost)
+        root->rb_leftmost = node;
+    if (rightmost)
+        root->rb_rightmost = node;
+    rb_insert_color(node, &root->rb_root);
+}
+
+static inline void rb_erase_cached(struct rb_node *node,
+                                   struct rb_root_cached *root)
+{
+    if (root->rb_leftmost == node)
+        root->rb_leftmost = rb_next(node);
+    if (root->rb_rightmost == node)
+        root->rb_rightmost = rb_prev(node);
+    rb_erase(node, &root->rb_root);
 }
 
 /**
@@ -108,6 +173,44 @@ static __always_inline struct rb_node *rb_find_add(
     return NULL;
 }
 
+/**
+ * rb_find_add_cached() - find equivalent @node in @tree, or add @node
+ * @node: node to look-for / insert
+ * @tree: leftmost/rightmost-cached tree to search / modify
+ * @cmp: operator defining the node order
+ *
+ * Returns the rb_node matching @node, or NULL when no match is found and @node
+ * is inserted.
+ */
+static __always_inline struct rb_node *rb_find_add_cached(
+    struct rb_node *node,
+    struct rb_root_cached *tree,
+    int (*cmp)(struct rb_node *, const struct rb_node *))
+{
+    struct rb_node **link = &tree->rb_root.rb_node;
+    struct rb_node *parent = NULL;
+    bool leftmost = true, rightmost = true;
+    int c;
+
+    while (*link) {
+        parent = *link;
+        c = cmp(node, parent);
+
+        if (c < 0) {
+            link = &parent->rb_left;
+            rightmost = false;
+        } else if (c > 0) {
+            link = &parent->rb_right;
+            leftmost = false;
+        } else
+            return parent;
+    }
+
+    rb_link_node(node, parent, link);
+    rb_insert_color_cached(node, tree, leftmost, rightmost);
+    return NULL;
+}
+
 /**
  * rb_find() - find @key in tree @tree
  * @key: key to match
@@ -123,9 +226,11 @@ static __always_inline struct rb_node *rb_find(
 {
     struct rb_node *node = tree->rb_node;
 
+    tree_stat_inc(lookups);
     while (node) {
         int c = cmp(key, node);
 
+        tree_stat_inc(lookup_cmps);
         if (c < 0)
             node = node->rb_left;
         else if (c > 0)
@@ -137,6 +242,65 @@ static __always_inline struct rb_node *rb_find(
     return NULL;
 }
 
+#define RB_FIND_BATCH 16
+
+/**
+ * rb_find_batch() - find @n keys in tree @tree
+ * @keys: keys to match
+ * @n: number of keys
+ * @out: receives the rb_node matching each key, or NULL
+ * @tree: tree to search
+ * @cmp: operator defining the node order
+ *
+ * Up to RB_FIND_BATCH searches descend in lockstep and prefetch their next
+ * node, so that cache misses of independent lookups overlap.
+ */
+static __always_inline void rb_find_batch(
+    const void *const *keys,
+    size_t n,
+    struct rb_node **out,
+    const struct rb_root *tree,
+    int (*cmp)(const void *key, const struct rb_node *))
+{
+    struct rb_node *cur[RB_FIND_BATCH];
+
+    for (size_t base = 0; base < n; base += RB_FIND_BATCH) {
+        size_t cnt = n - base < RB_FIND_BATCH ? n - base : RB_FIND_BATCH;
+        size_t active = 0;
+
+        for (size_t i = 0; i < cnt; i++) {
+            cur[i] = tree->rb_node;
+            out[base + i] = NULL;
+            if (cur[i])
+                active++;
+        }
+
+        while (active) {
+            for (size_t i = 0; i < cnt; i++) {
+                struct rb_node *node = cur[i];
+                if (!node)
+                    continue;
+
+                int c = cmp(keys[base + i], node);
+                if (c < 0)
+                    node = node->rb_left;
+                else if (c > 0)
+                    node = node->rb_right;
+                else {
+                    out[base + i] = node;
+                    node = NULL;
+                }
+
+                cur[i] = node;
+                if (node)
+                    __builtin_prefetch(node);
+                else
+                    active--;
+            }
+        }
+    }
+}
+
 /**
  * rb_remove() - remove @key in tree @tree
  * @key: key to remove
@@ -165,3 +329,21 @@ static __always_inline struct rb_node *rb_remove(
 
     return NULL;
 }
+
+/**
+ * rb_remove_cached() - remove @key in leftmost/rightmost-cached tree @tree
+ * @key: key to remove
+ * @tree: tree to modify
+ * @cmp: operator defining the node order
+ */
+static __always_inline struct rb_node *rb_remove_cached(
+    const void *key,
+    struct rb_root_cached *tree,
+    int (*cmp)(const void *key, const struct rb_node *))
+{
+    struct rb_node *node = rb_find(key, &tree->rb_root, cmp);
+
+    if (node)
+        rb_erase_cached(node, tree);
+    return node;
+}
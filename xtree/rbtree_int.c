@@ -3,7 +3,10 @@
 #include <stdlib.h>
 
 #include "common.h"
+#include "eytzinger.h"
+#include "pool.h"
 #include "rbtree.h"
+#include "rcu.h"
 
 
 struct rbtree_node {
@@ -12,58 +15,408 @@ struct rbtree_node {
 };
 
 struct rbtree_head {
-    struct rb_root root;
+    struct rb_root_cached root; /* leftmost/rightmost cached for pop_min/max */
+    struct node_pool *pool; /* NULL: nodes come from calloc() */
+    size_t count;
 };
 
+static inline struct rbtree_node *rbtree_node_alloc(struct rbtree_head *tree)
+{
+    if (tree->pool)
+        return pool_alloc(tree->pool);
+    return calloc(sizeof(struct rbtree_node), 1);
+}
+
+static inline void rbtree_node_free(struct rbtree_head *tree,
+                                    struct rbtree_node *n)
+{
+    if (tree->pool)
+        pool_free(tree->pool, n);
+    else
+        free(n);
+}
+
 static int rbtree_node_cmp(struct rb_node *a, const struct rb_node *b)
 {
     struct rbtree_node *na = rb_entry(a, struct rbtree_node, node);
     struct rbtree_node *nb = rb_entry(b, struct rbtree_node, node);
 
-    return (na->value - nb->value) < 0;
+    return cmp_int(na->value, nb->value);
 }
 
 static int rbtree_find_cmp(const void *key, const struct rb_node *n)
 {
     struct rbtree_node *na = rb_entry(n, struct rbtree_node, node);
     int value = *(int *) key;
-    return value - na->value;
+    return cmp_int(value, na->value);
 }
 
 void *rbtree_init()
 {
     struct rbtree_head *tree = calloc(sizeof(struct rbtree_head), 1);
-    tree->root = RB_ROOT;
+    tree->root = RB_ROOT_CACHED;
+    tree->pool = NULL;
+    return tree;
+}
+
+void *rbtree_init_pool()
+{
+    struct rbtree_head *tree = rbtree_init();
+    tree->pool = malloc(sizeof(struct node_pool));
+    assert(tree->pool);
+
+    pool_init(tree->pool, sizeof(struct rbtree_node), TREEINT_POOL_CHUNK);
     return tree;
 }
 
+int rbtree_destroy(void *ctx)
+{
+    struct rbtree_head *tree = (struct rbtree_head *) ctx;
+
+    assert(tree);
+    if (tree->pool) {
+        /* all nodes live in the pool: release them in bulk */
+        pool_destroy(tree->pool);
+        free(tree->pool);
+    } else {
+        /* Walk down to a leaf, free it and climb back to its parent. The
+         * parent link is read before the node goes away.
+         */
+        struct rb_node *node = tree->root.rb_root.rb_node;
+        while (node) {
+            if (node->rb_left) {
+                node = node->rb_left;
+                continue;
+            }
+            if (node->rb_right) {
+                node = node->rb_right;
+                continue;
+            }
+
+            struct rb_node *parent = rb_parent(node);
+            if (parent) {
+                if (parent->rb_left == node)
+                    parent->rb_left = NULL;
+                else
+                    parent->rb_right = NULL;
+            }
+            free(rb_entry(node, struct rbtree_node, node));
+            node = parent;
+        }
+    }
+
+    free(tree);
+    return 0;
+}
+
 int rbtree_insert(void *ctx, int a)
 {
     struct rbtree_head *tree = (struct rbtree_head *) ctx;
-    struct rbtree_node *n = calloc(sizeof(struct rbtree_node), 1);
+    struct rbtree_node *n = rbtree_node_alloc(tree);
+    assert(n);
     n->value = a;
 
-    if (rb_find_add(&n->node, &tree->root, rbtree_node_cmp))
+    if (rb_find_add_cached(&n->node, &tree->root, rbtree_node_cmp)) {
+        rbtree_node_free(tree, n);
         return -1;
+    }
 
+    tree->count++;
     return 0;
 }
 
+/* Load @n keys, sorted in ascending order without duplicates, into an empty
+ * tree through rb_build_sorted().
+ */
+int rbtree_build(void *ctx, const int *keys, size_t n)
+{
+    struct rbtree_head *tree = (struct rbtree_head *) ctx;
+    struct rb_node **nodes;
+    int ret;
+
+    for (size_t i = 1; i < n; i++) {
+        if (keys[i - 1] >= keys[i])
+            return -1;
+    }
+
+    nodes = malloc(sizeof(struct rb_node *) * n);
+    assert(nodes);
+    for (size_t i = 0; i < n; i++) {
+        struct rbtree_node *rn = rbtree_node_alloc(tree);
+        assert(rn);
+        rn->value = keys[i];
+        nodes[i] = &rn->node;
+    }
+
+    ret = rb_build_sorted(&tree->root.rb_root, nodes, n);
+    if (!ret) {
+        tree->root.rb_leftmost = n ? nodes[0] : NULL;
+        tree->root.rb_rightmost = n ? nodes[n - 1] : NULL;
+        tree->count = n;
+    } else {
+        for (size_t i = 0; i < n; i++)
+            rbtree_node_free(tree, rb_entry(nodes[i], struct rbtree_node, node));
+    }
+    free(nodes);
+    return ret;
+}
+
 void *rbtree_find(void *ctx, int a)
 {
     struct rbtree_head *tree = (struct rbtree_head *) ctx;
-    struct rb_node *f = rb_find(&a, &tree->root, rbtree_find_cmp);
+    struct rb_node *f = rb_find(&a, &tree->root.rb_root, rbtree_find_cmp);
     return f ? rb_entry(f, struct rbtree_node, node) : NULL;
 }
 
+int rbtree_lower_bound(void *ctx, int a, int *out)
+{
+    struct rbtree_head *tree = (struct rbtree_head *) ctx;
+    struct rb_node *node = tree->root.rb_root.rb_node, *lb = NULL;
+
+    while (node) {
+        int c = rbtree_find_cmp(&a, node);
+
+        if (c <= 0) {
+            lb = node;
+            if (!c)
+                break;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    if (!lb)
+        return -1;
+    *out = rb_entry(lb, struct rbtree_node, node)->value;
+    return 0;
+}
+
+int rbtree_stats(void *ctx, struct tree_shape *s)
+{
+    rb_stats(&((struct rbtree_head *) ctx)->root.rb_root, s);
+    return 0;
+}
+
+size_t rbtree_size(void *ctx)
+{
+    return ((struct rbtree_head *) ctx)->count;
+}
+
+size_t rbtree_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    struct rbtree_head *tree = (struct rbtree_head *) ctx;
+    size_t count = 0;
+
+    for (struct rb_node *n = rb_first_cached(&tree->root); n; n = rb_next(n)) {
+        cb(rb_entry(n, struct rbtree_node, node)->value, arg);
+        count++;
+    }
+    return count;
+}
+
+/* Read-only snapshot of the keys, see eytzinger.h. The tree is left as is. */
+void *rbtree_freeze(void *ctx)
+{
+    struct rbtree_head *tree = (struct rbtree_head *) ctx;
+    struct eyt_set *s;
+    size_t n = 0, i = 0;
+    int *keys;
+
+    for (struct rb_node *x = rb_first_cached(&tree->root); x; x = rb_next(x))
+        n++;
+    keys = malloc(sizeof(int) * (n ? n : 1));
+    assert(keys);
+    for (struct rb_node *x = rb_first_cached(&tree->root); x; x = rb_next(x))
+        keys[i++] = rb_entry(x, struct rbtree_node, node)->value;
+
+    s = eyt_create(keys, n);
+    free(keys);
+    return s;
+}
+
+#define RBTREE_BATCH 256
+
+void rbtree_find_batch(void *ctx, const int *keys, size_t n, void **out)
+{
+    struct rbtree_head *tree = (struct rbtree_head *) ctx;
+    const void *kp[RBTREE_BATCH];
+    struct rb_node *res[RBTREE_BATCH];
+
+    for (size_t base = 0; base < n; base += RBTREE_BATCH) {
+        size_t cnt = n - base < RBTREE_BATCH ? n - base : RBTREE_BATCH;
+
+        for (size_t i = 0; i < cnt; i++)
+            kp[i] = &keys[base + i];
+        rb_find_batch(kp, cnt, res, &tree->root.rb_root, rbtree_find_cmp);
+        for (size_t i = 0; i < cnt; i++)
+            out[base + i] =
+                res[i] ? rb_entry(res[i], struct rbtree_node, node) : NULL;
+    }
+}
+
 int rbtree_remove(void *ctx, int a)
 {
     struct rbtree_head *tree = (struct rbtree_head *) ctx;
-    struct rb_node *r = rb_remove(&a, &tree->root, rbtree_find_cmp);
+    struct rb_node *r = rb_remove_cached(&a, &tree->root, rbtree_find_cmp);
     if (!r)
         return -1;
 
     struct rbtree_node *rn = rb_entry(r, struct rbtree_node, node);
-    free(rn);
+    rbtree_node_free(tree, rn);
+    tree->count--;
+    return 0;
+}
+
+/* Remove the smallest key and store it in *out, -1 when the tree is empty.
+ * The cached leftmost node makes this O(1) plus the erase.
+ */
+int rbtree_pop_min(void *ctx, int *out)
+{
+    struct rbtree_head *tree = (struct rbtree_head *) ctx;
+    struct rb_node *first = rb_first_cached(&tree->root);
+    if (!first)
+        return -1;
+
+    struct rbtree_node *rn = rb_entry(first, struct rbtree_node, node);
+    *out = rn->value;
+    rb_erase_cached(first, &tree->root);
+    rbtree_node_free(tree, rn);
+    tree->count--;
+    return 0;
+}
+
+int rbtree_pop_max(void *ctx, int *out)
+{
+    struct rbtree_head *tree = (struct rbtree_head *) ctx;
+    struct rb_node *last = rb_last_cached(&tree->root);
+    if (!last)
+        return -1;
+
+    struct rbtree_node *rn = rb_entry(last, struct rbtree_node, node);
+    *out = rn->value;
+    rb_erase_cached(last, &tree->root);
+    rbtree_node_free(tree, rn);
+    tree->count--;
+    return 0;
+}
+
+/* Thread-safe front-end: writers are serialized and readers walk the tree
+ * without locking, validating their walk against the sequence counter of
+ * the rcu domain, see rcu.h.
+ */
+struct rbtree_rcu {
+    struct rbtree_head *tree;
+    struct rcu_domain rcu;
+};
+
+static void rbtree_rcu_free(void *ptr, void *arg)
+{
+    rbtree_node_free(arg, ptr);
+}
+
+void *rbtree_rcu_init()
+{
+    struct rbtree_rcu *t = malloc(sizeof(struct rbtree_rcu));
+    assert(t);
+
+    t->tree = rbtree_init();
+    rcu_init(&t->rcu, rbtree_rcu_free, t->tree);
+    return t;
+}
+
+int rbtree_rcu_destroy(void *ctx)
+{
+    struct rbtree_rcu *t = (struct rbtree_rcu *) ctx;
+
+    rcu_fini(&t->rcu);
+    rbtree_destroy(t->tree);
+    free(t);
     return 0;
 }
+
+int rbtree_rcu_insert(void *ctx, int a)
+{
+    struct rbtree_rcu *t = (struct rbtree_rcu *) ctx;
+
+    rcu_write_lock(&t->rcu);
+    int ret = rbtree_insert(t->tree, a);
+    rcu_write_unlock(&t->rcu);
+    return ret;
+}
+
+/* The node found may be freed as soon as the read-side section ends, so only
+ * its presence leaves the function, as the tree itself.
+ */
+void *rbtree_rcu_find(void *ctx, int a)
+{
+    struct rbtree_rcu *t = (struct rbtree_rcu *) ctx;
+    bool found;
+
+    rcu_read_lock(&t->rcu);
+    for (unsigned int tries = 1; tries < RCU_SPINS; tries++) {
+        unsigned int s = rcu_read_begin(&t->rcu);
+        if (s & 1)
+            continue;
+
+        struct rb_node *node = rcu_load(t->tree->root.rb_root.rb_node);
+        unsigned int steps = 0;
+        while (node) {
+            int c = rbtree_find_cmp(&a, node);
+            if (c == 0)
+                break;
+
+            node = rcu_load(*(c < 0 ? &node->rb_left : &node->rb_right));
+            if (++steps % RCU_CHECK_STEPS == 0 && rcu_read_changed(&t->rcu, s))
+                break;
+        }
+
+        if (!rcu_read_retry(&t->rcu, s)) {
+            rcu_read_unlock(&t->rcu);
+            return node ? ctx : NULL;
+        }
+    }
+    rcu_read_unlock(&t->rcu);
+
+    pthread_mutex_lock(&t->rcu.lock);
+    found = rb_find(&a, &t->tree->root.rb_root, rbtree_find_cmp);
+    pthread_mutex_unlock(&t->rcu.lock);
+    return found ? ctx : NULL;
+}
+
+int rbtree_rcu_remove(void *ctx, int a)
+{
+    struct rbtree_rcu *t = (struct rbtree_rcu *) ctx;
+
+    rcu_write_lock(&t->rcu);
+    struct rb_node *r = rb_remove_cached(&a, &t->tree->root, rbtree_find_cmp);
+    if (r) {
+        rcu_retire(&t->rcu, rb_entry(r, struct rbtree_node, node));
+        t->tree->count--;
+    }
+    rcu_write_unlock(&t->rcu);
+    return r ? 0 : -1;
+}
+
+/* Whole-tree walks take the writer mutex, which keeps every node alive and
+ * in place, without bumping the sequence counter that readers validate.
+ */
+size_t rbtree_rcu_size(void *ctx)
+{
+    struct rbtree_rcu *t = (struct rbtree_rcu *) ctx;
+
+    pthread_mutex_lock(&t->rcu.lock);
+    size_t count = rbtree_size(t->tree);
+    pthread_mutex_unlock(&t->rcu.lock);
+    return count;
+}
+
+size_t rbtree_rcu_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    struct rbtree_rcu *t = (struct rbtree_rcu *) ctx;
+
+    pthread_mutex_lock(&t->rcu.lock);
+    size_t count = rbtree_iterate(t->tree, cb, arg);
+    pthread_mutex_unlock(&t->rcu.lock);
+    return count;
+}
@@ -1,6 +1,34 @@
 #pragma once
 
+#include <stddef.h>
+
+#include "stats.h"
+
 extern void *rbtree_init();
+extern void *rbtree_init_pool();
+extern int rbtree_destroy(void *ctx);
 extern int rbtree_insert(void *ctx, int a);
+extern int rbtree_build(void *ctx, const int *keys, size_t n);
 extern void *rbtree_find(void *ctx, int a);
-extern int rbtree_remove(void *ctx, int a);
\ No newline at end of file
+extern int rbtree_remove(void *ctx, int a);
+extern int rbtree_lower_bound(void *ctx, int a, int *out);
+extern void *rbtree_freeze(void *ctx);
+extern int rbtree_pop_min(void *ctx, int *out);
+extern int rbtree_pop_max(void *ctx, int *out);
+extern size_t rbtree_size(void *ctx);
+extern int rbtree_stats(void *ctx, struct tree_shape *s);
+extern size_t rbtree_iterate(void *ctx, void (*cb)(int, void *), void *arg);
+extern void rbtree_find_batch(void *ctx,
+                              const int *keys,
+                              size_t n,
+                              void **out);
+
+extern void *rbtree_rcu_init();
+extern int rbtree_rcu_destroy(void *ctx);
+extern int rbtree_rcu_insert(void *ctx, int a);
+extern void *rbtree_rcu_find(void *ctx, int a);
+extern int rbtree_rcu_remove(void *ctx, int a);
+extern size_t rbtree_rcu_size(void *ctx);
+extern size_t rbtree_rcu_iterate(void *ctx,
+                                 void (*cb)(int, void *),
+                                 void *arg);
@@ -0,0 +1,247 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "pool.h"
+#include "rbtree.h"
+#include "rbtree_os.h"
+
+struct rbtree_os_node {
+    struct rb_node node;
+    int value;
+    unsigned int size; /* number of nodes in the subtree rooted here */
+};
+
+struct rbtree_os_head {
+    struct rb_root root;
+    struct node_pool pool;
+};
+
+#define rbtree_os_entry(n) rb_entry(n, struct rbtree_os_node, node)
+
+static inline unsigned int rbtree_os_nodes(const struct rb_node *n)
+{
+    return n ? rbtree_os_entry(n)->size : 0;
+}
+
+static inline unsigned int rbtree_os_compute(struct rb_node *n)
+{
+    return 1 + rbtree_os_nodes(n->rb_left) + rbtree_os_nodes(n->rb_right);
+}
+
+/* Augment callbacks keeping the subtree sizes up to date */
+static void rbtree_os_propagate(struct rb_node *rb, struct rb_node *stop)
+{
+    while (rb != stop) {
+        struct rbtree_os_node *n = rbtree_os_entry(rb);
+        unsigned int size = rbtree_os_compute(rb);
+
+        if (n->size == size)
+            break;
+        n->size = size;
+        rb = rb_parent(rb);
+    }
+}
+
+static void rbtree_os_copy(struct rb_node *old, struct rb_node *new)
+{
+    rbtree_os_entry(new)->size = rbtree_os_entry(old)->size;
+}
+
+static void rbtree_os_rotate(struct rb_node *old, struct rb_node *new)
+{
+    /* @new takes the place of @old, which becomes its child */
+    rbtree_os_entry(new)->size = rbtree_os_entry(old)->size;
+    rbtree_os_entry(old)->size = rbtree_os_compute(old);
+}
+
+static const struct rb_augment_callbacks rbtree_os_callbacks = {
+    .propagate = rbtree_os_propagate,
+    .copy = rbtree_os_copy,
+    .rotate = rbtree_os_rotate,
+};
+
+static inline int rbtree_os_cmp(int a, const struct rb_node *n)
+{
+    return cmp_int(a, rbtree_os_entry(n)->value);
+}
+
+static struct rb_node *rbtree_os_search(struct rbtree_os_head *tree, int a)
+{
+    struct rb_node *node = tree->root.rb_node;
+
+    while (node) {
+        int c = rbtree_os_cmp(a, node);
+
+        if (c < 0)
+            node = node->rb_left;
+        else if (c > 0)
+            node = node->rb_right;
+        else
+            return node;
+    }
+    return NULL;
+}
+
+void *rbtree_os_init()
+{
+    struct rbtree_os_head *tree = calloc(sizeof(struct rbtree_os_head), 1);
+    assert(tree);
+
+    tree->root = RB_ROOT;
+    pool_init(&tree->pool, sizeof(struct rbtree_os_node), TREEINT_POOL_CHUNK);
+    return tree;
+}
+
+int rbtree_os_destroy(void *ctx)
+{
+    struct rbtree_os_head *tree = (struct rbtree_os_head *) ctx;
+
+    assert(tree);
+    pool_destroy(&tree->pool);
+    free(tree);
+    return 0;
+}
+
+int rbtree_os_insert(void *ctx, int a)
+{
+    struct rbtree_os_head *tree = (struct rbtree_os_head *) ctx;
+    struct rb_node **link = &tree->root.rb_node, *parent = NULL;
+    struct rbtree_os_node *n;
+
+    /* Look for @a first: the sizes are only bumped on the way down once we
+     * know that a node gets added.
+     */
+    if (rbtree_os_search(tree, a))
+        return -1;
+
+    while (*link) {
+        parent = *link;
+        rbtree_os_entry(parent)->size++;
+        if (rbtree_os_cmp(a, parent) < 0)
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    n = pool_alloc(&tree->pool);
+    assert(n);
+    n->value = a;
+    n->size = 1;
+    rb_link_node(&n->node, parent, link);
+    rb_insert_augmented(&n->node, &tree->root, &rbtree_os_callbacks);
+    return 0;
+}
+
+void *rbtree_os_find(void *ctx, int a)
+{
+    struct rb_node *f = rbtree_os_search((struct rbtree_os_head *) ctx, a);
+    return f ? rbtree_os_entry(f) : NULL;
+}
+
+int rbtree_os_remove(void *ctx, int a)
+{
+    struct rbtree_os_head *tree = (struct rbtree_os_head *) ctx;
+    struct rb_node *f = rbtree_os_search(tree, a);
+
+    if (!f)
+        return -1;
+    rb_erase_augmented(f, &tree->root, &rbtree_os_callbacks);
+    pool_free(&tree->pool, rbtree_os_entry(f));
+    return 0;
+}
+
+int rbtree_os_lower_bound(void *ctx, int a, int *out)
+{
+    struct rbtree_os_head *tree = (struct rbtree_os_head *) ctx;
+    struct rb_node *node = tree->root.rb_node, *lb = NULL;
+
+    while (node) {
+        int c = rbtree_os_cmp(a, node);
+
+        if (c <= 0) {
+            lb = node;
+            if (!c)
+                break;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    if (!lb)
+        return -1;
+    *out = rbtree_os_entry(lb)->value;
+    return 0;
+}
+
+int rbtree_os_stats(void *ctx, struct tree_shape *s)
+{
+    rb_stats(&((struct rbtree_os_head *) ctx)->root, s);
+    return 0;
+}
+
+/* The root counts every node of the tree */
+size_t rbtree_os_size(void *ctx)
+{
+    struct rbtree_os_head *tree = (struct rbtree_os_head *) ctx;
+    return rbtree_os_nodes(tree->root.rb_node);
+}
+
+size_t rbtree_os_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    struct rbtree_os_head *tree = (struct rbtree_os_head *) ctx;
+    size_t count = 0;
+
+    for (struct rb_node *n = rb_first(&tree->root); n; n = rb_next(n)) {
+        cb(rbtree_os_entry(n)->value, arg);
+        count++;
+    }
+    return count;
+}
+
+/* Number of keys strictly smaller than @a, whether @a is present or not */
+size_t rbtree_os_rank(void *ctx, int a)
+{
+    struct rbtree_os_head *tree = (struct rbtree_os_head *) ctx;
+    struct rb_node *node = tree->root.rb_node;
+    size_t rank = 0;
+
+    while (node) {
+        int c = rbtree_os_cmp(a, node);
+
+        if (c <= 0) {
+            if (!c)
+                return rank + rbtree_os_nodes(node->rb_left);
+            node = node->rb_left;
+        } else {
+            rank += rbtree_os_nodes(node->rb_left) + 1;
+            node = node->rb_right;
+        }
+    }
+    return rank;
+}
+
+/* Store the key of rank @k, i.e. the (k + 1)-th smallest key, in *out.
+ * Returns -1 when the tree holds @k keys or less.
+ */
+int rbtree_os_select(void *ctx, size_t k, int *out)
+{
+    struct rbtree_os_head *tree = (struct rbtree_os_head *) ctx;
+    struct rb_node *node = tree->root.rb_node;
+
+    while (node) {
+        size_t left = rbtree_os_nodes(node->rb_left);
+
+        if (k < left) {
+            node = node->rb_left;
+        } else if (k > left) {
+            k -= left + 1;
+            node = node->rb_right;
+        } else {
+            *out = rbtree_os_entry(node)->value;
+            return 0;
+        }
+    }
+    return -1;
+}
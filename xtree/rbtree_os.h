@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "stats.h"
+
+/* Order-statistics tree: a red-black tree of integers where every node also
+ * counts the nodes of its subtree, which answers rank and select queries in
+ * O(log n).
+ */
+extern void *rbtree_os_init();
+extern int rbtree_os_destroy(void *ctx);
+extern int rbtree_os_insert(void *ctx, int a);
+extern void *rbtree_os_find(void *ctx, int a);
+extern int rbtree_os_remove(void *ctx, int a);
+extern int rbtree_os_lower_bound(void *ctx, int a, int *out);
+extern size_t rbtree_os_size(void *ctx);
+extern int rbtree_os_stats(void *ctx, struct tree_shape *s);
+extern size_t rbtree_os_iterate(void *ctx, void (*cb)(int, void *), void *arg);
+extern size_t rbtree_os_rank(void *ctx, int a);
+extern int rbtree_os_select(void *ctx, size_t k, int *out);
@@ -0,0 +1,172 @@
+/*
+ * Sequence counter and epoch-based reclamation, see rcu.h.
+ *
+ * Writers bracket their changes with two increments of rcu->seq. A reader
+ * whose walk overlapped a writer may have been misled by a rotation and has
+ * to restart. As in the kernel, aligned pointer stores are assumed not to
+ * tear, and readers load links with relaxed atomic accesses through
+ * rcu_load(). A walk caught in a transient cycle is cut short by the periodic
+ * counter checks.
+ *
+ * Each reader announces the global epoch it entered in, and the writer only
+ * advances the epoch once every active reader has caught up with it. An
+ * object unlinked during epoch e can no longer be reached by readers once the
+ * epoch reaches e + 2, and is freed then.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "rcu.h"
+
+/* retired objects between two reclamation attempts */
+#define RCU_RECLAIM_BATCH 64
+
+/* Reader slots are indexed by a small per-thread id, which returns to the
+ * free set when its thread exits.
+ */
+static atomic_bool rcu_ids[RCU_MAX_THREADS];
+static pthread_key_t rcu_key;
+static pthread_once_t rcu_once = PTHREAD_ONCE_INIT;
+static __thread int rcu_tid = -1;
+
+static void rcu_release_id(void *id)
+{
+    atomic_store(&rcu_ids[(intptr_t) id - 1], false);
+}
+
+static void rcu_init_key(void)
+{
+    pthread_key_create(&rcu_key, rcu_release_id);
+}
+
+static inline int rcu_self(void)
+{
+    if (rcu_tid >= 0)
+        return rcu_tid;
+
+    pthread_once(&rcu_once, rcu_init_key);
+    for (int i = 0; i < RCU_MAX_THREADS; i++) {
+        if (!atomic_exchange(&rcu_ids[i], true)) {
+            rcu_tid = i;
+            pthread_setspecific(rcu_key, (void *) (intptr_t) (i + 1));
+            return i;
+        }
+    }
+
+    assert(!"too many rcu threads");
+    abort();
+}
+
+void rcu_init(struct rcu_domain *rcu,
+              void (*free)(void *ptr, void *arg),
+              void *arg)
+{
+    pthread_mutex_init(&rcu->lock, NULL);
+    atomic_init(&rcu->seq, 0);
+    atomic_init(&rcu->epoch, 0);
+    for (int i = 0; i < RCU_MAX_THREADS; i++)
+        atomic_init(&rcu->readers[i], 0);
+
+    rcu->free = free;
+    rcu->arg = arg;
+    rcu->retired = NULL;
+    rcu->nretired = rcu->retired_cap = 0;
+    rcu->reclaim_at = RCU_RECLAIM_BATCH;
+}
+
+/* No reader may be running anymore */
+void rcu_fini(struct rcu_domain *rcu)
+{
+    for (size_t i = 0; i < rcu->nretired; i++)
+        rcu->free(rcu->retired[i].ptr, rcu->arg);
+
+    free(rcu->retired);
+    rcu->retired = NULL;
+    rcu->nretired = 0;
+    pthread_mutex_destroy(&rcu->lock);
+}
+
+void rcu_write_lock(struct rcu_domain *rcu)
+{
+    pthread_mutex_lock(&rcu->lock);
+
+    unsigned int s = atomic_load_explicit(&rcu->seq, memory_order_relaxed);
+    atomic_store_explicit(&rcu->seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void rcu_write_unlock(struct rcu_domain *rcu)
+{
+    unsigned int s = atomic_load_explicit(&rcu->seq, memory_order_relaxed);
+    atomic_store_explicit(&rcu->seq, s + 1, memory_order_release);
+
+    pthread_mutex_unlock(&rcu->lock);
+}
+
+/* Advance the epoch if every active reader runs in the current one, then
+ * free the objects retired two epochs ago or earlier.
+ */
+static void rcu_reclaim(struct rcu_domain *rcu)
+{
+    unsigned long e = atomic_load(&rcu->epoch);
+    size_t kept = 0;
+
+    for (int i = 0; i < RCU_MAX_THREADS; i++) {
+        unsigned long r = atomic_load(&rcu->readers[i]);
+        if ((r & 1) && (r >> 1) != e)
+            goto free_old;
+    }
+    atomic_store(&rcu->epoch, ++e);
+
+free_old:
+    for (size_t i = 0; i < rcu->nretired; i++) {
+        if (rcu->retired[i].epoch + 2 <= e)
+            rcu->free(rcu->retired[i].ptr, rcu->arg);
+        else
+            rcu->retired[kept++] = rcu->retired[i];
+    }
+    rcu->nretired = kept;
+}
+
+/* Called with the write lock held */
+void rcu_retire(struct rcu_domain *rcu, void *ptr)
+{
+    if (rcu->nretired == rcu->retired_cap) {
+        size_t cap =
+            rcu->retired_cap ? rcu->retired_cap * 2 : RCU_RECLAIM_BATCH * 2;
+        struct rcu_retired *r =
+            realloc(rcu->retired, sizeof(struct rcu_retired) * cap);
+        assert(r);
+        rcu->retired = r;
+        rcu->retired_cap = cap;
+    }
+
+    rcu->retired[rcu->nretired].ptr = ptr;
+    rcu->retired[rcu->nretired].epoch = atomic_load(&rcu->epoch);
+    rcu->nretired++;
+
+    /* a reader lagging behind blocks the epoch: do not rescan the whole list
+     * on every removal while it does
+     */
+    if (rcu->nretired >= rcu->reclaim_at) {
+        rcu_reclaim(rcu);
+        rcu->reclaim_at = rcu->nretired + RCU_RECLAIM_BATCH;
+    }
+}
+
+void rcu_read_lock(struct rcu_domain *rcu)
+{
+    atomic_ulong *slot = &rcu->readers[rcu_self()];
+    unsigned long e = atomic_load(&rcu->epoch);
+
+    atomic_store(slot, e << 1 | 1);
+    /* the announcement must be visible before any object is loaded */
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+void rcu_read_unlock(struct rcu_domain *rcu)
+{
+    atomic_store_explicit(&rcu->readers[rcu_self()], 0, memory_order_release);
+}
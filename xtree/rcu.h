@@ -0,0 +1,83 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "common.h"
+
+/* Read-mostly synchronization shared by the concurrent tree front-ends.
+ *
+ * Writers are serialized by a mutex and publish their changes through a
+ * sequence counter, which is odd while a writer is in progress. Readers take
+ * no lock: they sample the counter with rcu_read_begin(), walk the structure
+ * and validate the walk with rcu_read_retry(). Objects unlinked by a writer
+ * are passed to rcu_retire() and freed once no reader can still hold them,
+ * which is tracked with epoch-based reclamation.
+ *
+ * Walks must be bracketed by rcu_read_lock() and rcu_read_unlock(), and the
+ * objects they find stay valid until rcu_read_unlock(). Links followed by
+ * readers are loaded with rcu_load(), so writers must update them with
+ * WRITE_ONCE() even though they hold the lock.
+ */
+#define RCU_MAX_THREADS 64
+
+/* steps between two sequence checks of a reader walk */
+#define RCU_CHECK_STEPS 64
+
+/* Failed walks before a reader falls back to the writer lock. Unlike in the
+ * kernel, the writer may be preempted in the middle of its update, and
+ * spinning readers would then only delay it further.
+ */
+#define RCU_SPINS 16
+
+#define rcu_load(p) READ_ONCE(p)
+
+struct rcu_retired {
+    void *ptr;
+    unsigned long epoch;
+};
+
+struct rcu_domain {
+    pthread_mutex_t lock;
+    atomic_uint seq;
+    atomic_ulong epoch;
+    /* per thread: 0 when outside a read-side section, epoch << 1 | 1 inside */
+    atomic_ulong readers[RCU_MAX_THREADS];
+
+    void (*free)(void *ptr, void *arg);
+    void *arg;
+    struct rcu_retired *retired;
+    size_t nretired, retired_cap;
+    size_t reclaim_at; /* next reclamation attempt, in retired objects */
+};
+
+void rcu_init(struct rcu_domain *rcu,
+              void (*free)(void *ptr, void *arg),
+              void *arg);
+void rcu_fini(struct rcu_domain *rcu);
+void rcu_write_lock(struct rcu_domain *rcu);
+void rcu_write_unlock(struct rcu_domain *rcu);
+void rcu_retire(struct rcu_domain *rcu, void *ptr);
+void rcu_read_lock(struct rcu_domain *rcu);
+void rcu_read_unlock(struct rcu_domain *rcu);
+
+static inline unsigned int rcu_read_begin(struct rcu_domain *rcu)
+{
+    return atomic_load_explicit(&rcu->seq, memory_order_acquire);
+}
+
+/* true when a writer ran since rcu_read_begin() returned @seq */
+static inline bool rcu_read_retry(struct rcu_domain *rcu, unsigned int seq)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return (seq & 1) ||
+           atomic_load_explicit(&rcu->seq, memory_order_relaxed) != seq;
+}
+
+/* cheap check for the middle of a walk, see RCU_CHECK_STEPS */
+static inline bool rcu_read_changed(struct rcu_domain *rcu, unsigned int seq)
+{
+    return atomic_load_explicit(&rcu->seq, memory_order_acquire) != seq;
+}
@@ -0,0 +1,205 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sharded_treeint.h"
+
+static inline struct sharded_shard *sharded_shard_of(struct sharded_treeint *s,
+                                                     int a)
+{
+    uint32_t k = (uint32_t) a;
+
+    if (s->shift == 32)
+        return &s->shards[0];
+
+    if (s->partition == SHARDED_HASH)
+        k *= 2654435761U; /* Knuth's multiplicative hash */
+    else
+        k ^= 0x80000000U; /* order-preserving map of int to unsigned */
+    return &s->shards[k >> s->shift];
+}
+
+struct sharded_treeint *sharded_treeint_create(
+    const struct treeint_ops *ops,
+    unsigned int shard_bits,
+    enum sharded_partition partition)
+{
+    unsigned int nshards = 1U << shard_bits;
+    struct sharded_treeint *s;
+
+    assert(ops->lower_bound && ops->size && shard_bits < 16);
+    s = aligned_alloc(64, sizeof(struct sharded_treeint) +
+                              sizeof(struct sharded_shard) * nshards);
+    if (!s)
+        return NULL;
+
+    s->ops = ops;
+    s->partition = partition;
+    s->shift = 32 - shard_bits;
+    s->nshards = nshards;
+    for (unsigned int i = 0; i < nshards; i++) {
+        pthread_mutex_init(&s->shards[i].lock, NULL);
+        s->shards[i].ctx = ops->init();
+        assert(s->shards[i].ctx);
+    }
+    return s;
+}
+
+int sharded_treeint_destroy(void *ctx)
+{
+    struct sharded_treeint *s = (struct sharded_treeint *) ctx;
+
+    for (unsigned int i = 0; i < s->nshards; i++) {
+        s->ops->destroy(s->shards[i].ctx);
+        pthread_mutex_destroy(&s->shards[i].lock);
+    }
+    free(s);
+    return 0;
+}
+
+int sharded_treeint_insert(void *ctx, int a)
+{
+    struct sharded_treeint *s = (struct sharded_treeint *) ctx;
+    struct sharded_shard *sh = sharded_shard_of(s, a);
+
+    pthread_mutex_lock(&sh->lock);
+    int ret = s->ops->insert(sh->ctx, a);
+    pthread_mutex_unlock(&sh->lock);
+    return ret;
+}
+
+/* The returned entry is only stable as long as nobody removes @a */
+void *sharded_treeint_find(void *ctx, int a)
+{
+    struct sharded_treeint *s = (struct sharded_treeint *) ctx;
+    struct sharded_shard *sh = sharded_shard_of(s, a);
+
+    pthread_mutex_lock(&sh->lock);
+    void *ret = s->ops->find(sh->ctx, a);
+    pthread_mutex_unlock(&sh->lock);
+    return ret;
+}
+
+int sharded_treeint_remove(void *ctx, int a)
+{
+    struct sharded_treeint *s = (struct sharded_treeint *) ctx;
+    struct sharded_shard *sh = sharded_shard_of(s, a);
+
+    pthread_mutex_lock(&sh->lock);
+    int ret = s->ops->remove(sh->ctx, a);
+    pthread_mutex_unlock(&sh->lock);
+    return ret;
+}
+
+/* Sum of the shard sizes, each read under its lock: concurrent writers may
+ * make it stale by the time it returns.
+ */
+size_t sharded_treeint_size(void *ctx)
+{
+    struct sharded_treeint *s = (struct sharded_treeint *) ctx;
+    size_t count = 0;
+
+    for (unsigned int i = 0; i < s->nshards; i++) {
+        pthread_mutex_lock(&s->shards[i].lock);
+        count += s->ops->size(s->shards[i].ctx);
+        pthread_mutex_unlock(&s->shards[i].lock);
+    }
+    return count;
+}
+
+static int sharded_shard_lower_bound(struct sharded_treeint *s,
+                                     unsigned int i,
+                                     int a,
+                                     int *out)
+{
+    struct sharded_shard *sh = &s->shards[i];
+
+    pthread_mutex_lock(&sh->lock);
+    int ret = s->ops->lower_bound(sh->ctx, a, out);
+    pthread_mutex_unlock(&sh->lock);
+    return ret;
+}
+
+int sharded_treeint_lower_bound(void *ctx, int a, int *out)
+{
+    struct sharded_treeint *s = (struct sharded_treeint *) ctx;
+    int found = 0, k;
+
+    /* Range partitioning keeps the answer in the shard of @a or in a later
+     * one, hashing may put it anywhere.
+     */
+    unsigned int i = s->partition == SHARDED_RANGE
+                         ? (unsigned int) (sharded_shard_of(s, a) - s->shards)
+                         : 0;
+    for (; i < s->nshards; i++) {
+        if (sharded_shard_lower_bound(s, i, a, &k))
+            continue;
+        if (!found || k < *out)
+            *out = k;
+        found = 1;
+        if (s->partition == SHARDED_RANGE)
+            break;
+    }
+    return found ? 0 : -1;
+}
+
+int sharded_iter_init(struct sharded_iter *it, struct sharded_treeint *s)
+{
+    it->s = s;
+    it->keys = malloc(sizeof(int) * s->nshards);
+    it->valid = malloc(s->nshards);
+    if (!it->keys || !it->valid) {
+        sharded_iter_fini(it);
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < s->nshards; i++)
+        it->valid[i] = !sharded_shard_lower_bound(s, i, INT_MIN, &it->keys[i]);
+    return 0;
+}
+
+/* Store the next key in ascending order in *key, returns -1 at the end. The
+ * traversal is weakly consistent: keys inserted or removed concurrently may
+ * or may not be seen.
+ */
+int sharded_iter_next(struct sharded_iter *it, int *key)
+{
+    struct sharded_treeint *s = it->s;
+    int min = -1;
+
+    for (unsigned int i = 0; i < s->nshards; i++) {
+        if (it->valid[i] && (min < 0 || it->keys[i] < it->keys[min]))
+            min = i;
+    }
+    if (min < 0)
+        return -1;
+
+    *key = it->keys[min];
+    it->valid[min] = *key < INT_MAX &&
+                     !sharded_shard_lower_bound(s, min, *key + 1,
+                                                &it->keys[min]);
+    return 0;
+}
+
+void sharded_iter_fini(struct sharded_iter *it)
+{
+    free(it->keys);
+    free(it->valid);
+}
+
+size_t sharded_treeint_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    struct sharded_iter it;
+    size_t count = 0;
+    int key;
+
+    if (sharded_iter_init(&it, (struct sharded_treeint *) ctx))
+        return 0;
+    while (!sharded_iter_next(&it, &key)) {
+        cb(key, arg);
+        count++;
+    }
+    sharded_iter_fini(&it);
+    return count;
+}
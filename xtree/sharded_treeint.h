@@ -0,0 +1,57 @@
+#pragma once
+
+#include <pthread.h>
+
+#include "treeint.h"
+
+/* A set of integers spread over independent trees, called shards, each one
+ * guarded by its own lock, so that threads working on different shards do not
+ * contend. Keys are assigned to shards either by hashing, which balances the
+ * load whatever the key distribution, or by the top bits of the key, which
+ * keeps every shard a contiguous key range.
+ *
+ * The shards are created through a struct treeint_ops, which must provide
+ * lower_bound for ordered iteration, and size.
+ */
+enum sharded_partition {
+    SHARDED_HASH,
+    SHARDED_RANGE,
+};
+
+struct sharded_shard {
+    pthread_mutex_t lock;
+    void *ctx;
+} __attribute__((aligned(64)));
+
+struct sharded_treeint {
+    const struct treeint_ops *ops;
+    enum sharded_partition partition;
+    unsigned int shift; /* 32 - log2(number of shards) */
+    unsigned int nshards;
+    struct sharded_shard shards[];
+};
+
+/* Ordered traversal merging the shards: a cursor per shard, the smallest one
+ * is returned and advanced.
+ */
+struct sharded_iter {
+    struct sharded_treeint *s;
+    int *keys;
+    unsigned char *valid;
+};
+
+struct sharded_treeint *sharded_treeint_create(
+    const struct treeint_ops *ops,
+    unsigned int shard_bits,
+    enum sharded_partition partition);
+int sharded_treeint_destroy(void *ctx);
+int sharded_treeint_insert(void *ctx, int a);
+void *sharded_treeint_find(void *ctx, int a);
+int sharded_treeint_remove(void *ctx, int a);
+size_t sharded_treeint_size(void *ctx);
+int sharded_treeint_lower_bound(void *ctx, int a, int *out);
+size_t sharded_treeint_iterate(void *ctx, void (*cb)(int, void *), void *arg);
+
+int sharded_iter_init(struct sharded_iter *it, struct sharded_treeint *s);
+int sharded_iter_next(struct sharded_iter *it, int *key);
+void sharded_iter_fini(struct sharded_iter *it);
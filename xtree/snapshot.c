@@ -0,0 +1,90 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+_Static_assert(sizeof(struct snap_header) <= SNAP_HEADER_SIZE, "header");
+
+/* Write @s to @path, replacing the file. Returns -1 on I/O errors. */
+int snap_save(const char *path, const struct eyt_set *s)
+{
+    char header[SNAP_HEADER_SIZE] = {0};
+    struct snap_header h = {
+        .magic = SNAP_MAGIC,
+        .version = SNAP_VERSION,
+        .layout = SNAP_EYTZINGER,
+        .key_size = sizeof(int),
+        .count = s->n,
+    };
+    FILE *f = fopen(path, "wb");
+    int ret = 0;
+
+    if (!f)
+        return -1;
+    memcpy(header, &h, sizeof(h));
+    if (fwrite(header, sizeof(header), 1, f) != 1 ||
+        fwrite(s->keys, sizeof(int), s->n + 1, f) != s->n + 1)
+        ret = -1;
+    if (fclose(f))
+        ret = -1;
+    return ret;
+}
+
+/* Map the snapshot at @path read-only. Nothing is read up front: pages are
+ * faulted in by the lookups that touch them. Returns NULL when the file
+ * cannot be mapped or is not a snapshot this code understands.
+ */
+struct snap *snap_open(const char *path)
+{
+    const struct snap_header *h;
+    struct snap *sn;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) || (size_t) st.st_size < SNAP_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    h = map;
+    if (memcmp(h->magic, SNAP_MAGIC, sizeof(h->magic)) ||
+        h->version != SNAP_VERSION || h->layout != SNAP_EYTZINGER ||
+        h->key_size != sizeof(int) ||
+        h->count >= (st.st_size - SNAP_HEADER_SIZE) / sizeof(int))
+        goto fail;
+
+    sn = malloc(sizeof(struct snap));
+    if (!sn)
+        goto fail;
+    sn->set.n = h->count;
+    sn->set.keys = (int *) ((char *) map + SNAP_HEADER_SIZE);
+    sn->map = map;
+    sn->len = st.st_size;
+    return sn;
+
+fail:
+    munmap(map, st.st_size);
+    return NULL;
+}
+
+int snap_close(void *ctx)
+{
+    struct snap *sn = (struct snap *) ctx;
+
+    munmap(sn->map, sn->len);
+    free(sn);
+    return 0;
+}
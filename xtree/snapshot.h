@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "eytzinger.h"
+
+/* On-disk snapshot of an integer set, mapped back with mmap(). The file is a
+ * header followed by the keys in the layout it names:
+ *
+ *   0   magic     "TISNAP\0\0"
+ *   8   version   SNAP_VERSION, bumped on incompatible changes
+ *   12  layout    enum snap_layout
+ *   16  key_size  sizeof(int)
+ *   20  reserved  0
+ *   24  count     number of keys
+ *   32  ...       zero up to SNAP_HEADER_SIZE
+ *   64  keys      SNAP_EYTZINGER: count + 1 slots as in struct eyt_set
+ *
+ * Fields are in host byte order; a loader on a machine of the other
+ * endianness sees a version it does not know and refuses the file. The keys
+ * start on a cache line, so the mapped array is searched in place.
+ */
+#define SNAP_MAGIC "TISNAP\0"
+#define SNAP_VERSION 1
+#define SNAP_HEADER_SIZE 64
+
+enum snap_layout {
+    SNAP_EYTZINGER = 1,
+};
+
+struct snap_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;
+    uint32_t key_size;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+/* A mapped snapshot. It starts with a struct eyt_set pointing into the
+ * mapping, so that the eyt_*() lookups work on it directly.
+ */
+struct snap {
+    struct eyt_set set;
+    void *map;
+    size_t len;
+};
+
+int snap_save(const char *path, const struct eyt_set *s);
+struct snap *snap_open(const char *path);
+int snap_close(void *ctx);
@@ -0,0 +1,27 @@
+#include <string.h>
+
+#include "stats.h"
+
+#ifdef TREE_STATS
+__thread struct tree_counters tree_counters;
+#endif
+
+void tree_shape_init(struct tree_shape *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+void tree_shape_add(struct tree_shape *s, unsigned int depth)
+{
+    s->nodes++;
+    s->avg_depth += depth; /* summed here, averaged by tree_shape_done() */
+    if (depth > s->height)
+        s->height = depth;
+    s->depth[depth < TREE_SHAPE_DEPTHS ? depth - 1 : TREE_SHAPE_DEPTHS - 1]++;
+}
+
+void tree_shape_done(struct tree_shape *s)
+{
+    if (s->nodes)
+        s->avg_depth /= s->nodes;
+}
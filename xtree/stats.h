@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Event counters of the tree cores, compiled in with -DTREE_STATS (make
+ * STATS=1) and out otherwise, so that regular builds pay nothing. They are
+ * per thread, and shared by XTree and the red-black tree: callers read them
+ * before and after the work they want to measure.
+ *
+ * A rebalance is one xt_update() walk or one red-black fixup after an insert
+ * or an erase; its steps are the nodes it went through on its way up. The
+ * lookups are the searches of xt_find(), xt_search() and rb_find().
+ */
+struct tree_counters {
+    uint64_t rebalances;
+    uint64_t rebalance_steps;
+    uint64_t rebalance_max_steps; /* longest single rebalance */
+    uint64_t rotations;
+    uint64_t lookups;
+    uint64_t lookup_cmps;
+};
+
+#ifdef TREE_STATS
+extern __thread struct tree_counters tree_counters;
+
+#define tree_stat_inc(field) (tree_counters.field++)
+#define tree_stat_step(steps)                                   \
+    do {                                                        \
+        tree_counters.rebalance_steps++;                        \
+        if (++(steps) > tree_counters.rebalance_max_steps)      \
+            tree_counters.rebalance_max_steps = (steps);        \
+    } while (0)
+#else
+#define tree_stat_inc(field) ((void) 0)
+#define tree_stat_step(steps) ((void) (steps))
+#endif
+
+/* Shape of a tree, gathered by xt_stats() and rb_stats() in one walk:
+ * depth[d - 1] counts the nodes at depth d, the root being at depth 1, and
+ * the last slot also counts every deeper node.
+ */
+#define TREE_SHAPE_DEPTHS 64
+
+struct tree_shape {
+    size_t nodes;
+    unsigned int height;
+    double avg_depth;
+    size_t depth[TREE_SHAPE_DEPTHS];
+};
+
+void tree_shape_init(struct tree_shape *s);
+void tree_shape_add(struct tree_shape *s, unsigned int depth);
+void tree_shape_done(struct tree_shape *s);
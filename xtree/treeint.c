@@ -1,21 +1,31 @@
 #include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "bench.h"
+#include "bptree.h"
 #include "common.h"
+#include "eytzinger.h"
+#include "interval_tree.h"
+#include "perf.h"
 #include "rbtree_int.h"
+#include "rbtree_os.h"
+#include "sharded_treeint.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "treeint.h"
+#include "treeint_kv.h"
 #include "treeint_xt.h"
 
-struct treeint_ops {
-    void *(*init)();
-    int (*destroy)(void *);
-    int (*insert)(void *, int);
-    void *(*find)(void *, int);
-    int (*remove)(void *, int);
-};
-
 static struct treeint_ops *ops;
 
 static struct treeint_ops xt_ops = {
@@ -24,16 +34,386 @@ static struct treeint_ops xt_ops = {
     .insert = treeint_xt_insert,
     .find = treeint_xt_find,
     .remove = treeint_xt_remove,
+    .iterate = treeint_xt_iterate,
+    .size = treeint_xt_size,
+    .build = treeint_xt_build,
+    .find_batch = treeint_xt_find_batch,
+    .range = treeint_xt_range,
+    .height = treeint_xt_height,
+    .depth = treeint_xt_depth,
+    .stats = treeint_xt_stats,
+    .balance = treeint_xt_balance,
+    .lower_bound = treeint_xt_lower_bound,
+    .pop_min = treeint_xt_pop_min,
+    .pop_max = treeint_xt_pop_max,
+    .freeze = treeint_xt_freeze,
+};
+
+static struct treeint_ops xt_pool_ops = {
+    .init = treeint_xt_init_pool,
+    .destroy = treeint_xt_destroy,
+    .insert = treeint_xt_insert,
+    .find = treeint_xt_find,
+    .remove = treeint_xt_remove,
+    .iterate = treeint_xt_iterate,
+    .size = treeint_xt_size,
+    .build = treeint_xt_build,
+    .find_batch = treeint_xt_find_batch,
+    .range = treeint_xt_range,
+    .height = treeint_xt_height,
+    .stats = treeint_xt_stats,
+    .balance = treeint_xt_balance,
+    .lower_bound = treeint_xt_lower_bound,
+    .pop_min = treeint_xt_pop_min,
+    .pop_max = treeint_xt_pop_max,
+    .freeze = treeint_xt_freeze,
+};
+
+static struct treeint_ops xt_deferred_ops = {
+    .init = treeint_xt_init_deferred,
+    .destroy = treeint_xt_destroy,
+    .insert = treeint_xt_insert,
+    .find = treeint_xt_find,
+    .remove = treeint_xt_remove,
+    .iterate = treeint_xt_iterate,
+    .size = treeint_xt_size,
+    .height = treeint_xt_height,
+    .stats = treeint_xt_stats,
+};
+
+static struct treeint_ops xt_manual_ops = {
+    .init = treeint_xt_init_manual,
+    .destroy = treeint_xt_destroy,
+    .insert = treeint_xt_insert,
+    .find = treeint_xt_find,
+    .remove = treeint_xt_remove,
+    .iterate = treeint_xt_iterate,
+    .size = treeint_xt_size,
+    .rebalance = treeint_xt_rebalance,
+    .chain = treeint_xt_chain,
+    .height = treeint_xt_height,
+    .stats = treeint_xt_stats,
+};
+
+static struct treeint_ops xt_promote_ops = {
+    .init = treeint_xt_init_promote,
+    .destroy = treeint_xt_destroy,
+    .insert = treeint_xt_insert,
+    .find = treeint_xt_find,
+    .remove = treeint_xt_remove,
+    .iterate = treeint_xt_iterate,
+    .size = treeint_xt_size,
+    .height = treeint_xt_height,
+    .depth = treeint_xt_depth,
+    .stats = treeint_xt_stats,
+};
+
+static struct treeint_ops xt_locked_ops = {
+    .init = treeint_xt_locked_init,
+    .destroy = treeint_xt_locked_destroy,
+    .insert = treeint_xt_locked_insert,
+    .find = treeint_xt_locked_find,
+    .remove = treeint_xt_locked_remove,
+    .iterate = treeint_xt_locked_iterate,
+    .size = treeint_xt_locked_size,
+    .concurrent = true,
+};
+
+static struct treeint_ops xt_rcu_ops = {
+    .init = treeint_xt_rcu_init,
+    .destroy = treeint_xt_rcu_destroy,
+    .insert = treeint_xt_rcu_insert,
+    .find = treeint_xt_rcu_find,
+    .remove = treeint_xt_rcu_remove,
+    .iterate = treeint_xt_rcu_iterate,
+    .size = treeint_xt_rcu_size,
+    .concurrent = true,
+};
+
+static struct treeint_ops xt_inline_ops = {
+    .init = treeint_xt_init,
+    .destroy = treeint_xt_destroy,
+    .insert = treeint_xt_insert_inline,
+    .find = treeint_xt_find_inline,
+    .remove = treeint_xt_remove_inline,
+    .iterate = treeint_xt_iterate,
+    .size = treeint_xt_size,
+    .build = treeint_xt_build,
+    .find_batch = treeint_xt_find_batch,
+    .range = treeint_xt_range,
+    .height = treeint_xt_height,
+    .stats = treeint_xt_stats,
+    .balance = treeint_xt_balance,
+    .lower_bound = treeint_xt_lower_bound,
+    .pop_min = treeint_xt_pop_min,
+    .pop_max = treeint_xt_pop_max,
+    .freeze = treeint_xt_freeze,
+};
+
+static struct treeint_ops xti_ops = {
+    .init = treeint_xti_init,
+    .destroy = treeint_xti_destroy,
+    .insert = treeint_xti_insert,
+    .find = treeint_xti_find,
+    .remove = treeint_xti_remove,
+    .iterate = treeint_xti_iterate,
+    .size = treeint_xti_size,
 };
 
 static struct treeint_ops rb_ops = {
     .init = rbtree_init,
+    .destroy = rbtree_destroy,
     .insert = rbtree_insert,
     .find = rbtree_find,
     .remove = rbtree_remove,
+    .iterate = rbtree_iterate,
+    .size = rbtree_size,
+    .stats = rbtree_stats,
+    .build = rbtree_build,
+    .find_batch = rbtree_find_batch,
+    .lower_bound = rbtree_lower_bound,
+    .pop_min = rbtree_pop_min,
+    .pop_max = rbtree_pop_max,
+    .freeze = rbtree_freeze,
 };
 
-#define rand_key(sz) rand() % ((sz) -1)
+static struct treeint_ops rb_os_ops = {
+    .init = rbtree_os_init,
+    .destroy = rbtree_os_destroy,
+    .insert = rbtree_os_insert,
+    .find = rbtree_os_find,
+    .remove = rbtree_os_remove,
+    .iterate = rbtree_os_iterate,
+    .size = rbtree_os_size,
+    .stats = rbtree_os_stats,
+    .lower_bound = rbtree_os_lower_bound,
+    .rank = rbtree_os_rank,
+    .select = rbtree_os_select,
+};
+
+static struct treeint_ops rb_rcu_ops = {
+    .init = rbtree_rcu_init,
+    .destroy = rbtree_rcu_destroy,
+    .insert = rbtree_rcu_insert,
+    .find = rbtree_rcu_find,
+    .remove = rbtree_rcu_remove,
+    .iterate = rbtree_rcu_iterate,
+    .size = rbtree_rcu_size,
+    .concurrent = true,
+};
+
+static struct treeint_ops rb_pool_ops = {
+    .init = rbtree_init_pool,
+    .destroy = rbtree_destroy,
+    .insert = rbtree_insert,
+    .find = rbtree_find,
+    .remove = rbtree_remove,
+    .iterate = rbtree_iterate,
+    .size = rbtree_size,
+    .stats = rbtree_stats,
+    .build = rbtree_build,
+    .find_batch = rbtree_find_batch,
+    .lower_bound = rbtree_lower_bound,
+    .pop_min = rbtree_pop_min,
+    .pop_max = rbtree_pop_max,
+    .freeze = rbtree_freeze,
+};
+
+static struct treeint_ops bp_ops = {
+    .init = bptree_init,
+    .destroy = bptree_destroy,
+    .insert = bptree_insert,
+    .find = bptree_find,
+    .remove = bptree_remove,
+    .iterate = bptree_iterate,
+    .size = bptree_size,
+    .build = bptree_build,
+    .range = bptree_range,
+    .height = bptree_height,
+    .lower_bound = bptree_lower_bound,
+};
+
+/* Snapshots returned by the freeze hooks. Read-only: no insert or remove. */
+static struct treeint_ops frozen_ops = {
+    .destroy = eyt_destroy,
+    .find = eyt_find,
+    .lower_bound = eyt_lower_bound,
+    .iterate = eyt_iterate,
+};
+
+static struct treeint_kv_ops xt_kv_ops = {
+    .init = treeint_xt_kv_init,
+    .destroy = treeint_xt_kv_destroy,
+    .insert = treeint_xt_kv_insert,
+    .find = treeint_xt_kv_find,
+    .remove = treeint_xt_kv_remove,
+};
+
+static struct treeint_kv_ops rb_kv_ops = {
+    .init = rbtree_kv_init,
+    .destroy = rbtree_kv_destroy,
+    .insert = rbtree_kv_insert,
+    .find = rbtree_kv_find,
+    .remove = rbtree_kv_remove,
+};
+
+/* Sharded sets: 2^SHARD_BITS trees each, see sharded_treeint.h */
+#define SHARD_BITS 4
+
+static void *sharded_xt_init()
+{
+    return sharded_treeint_create(&xt_pool_ops, SHARD_BITS, SHARDED_HASH);
+}
+
+static void *sharded_rb_init()
+{
+    return sharded_treeint_create(&rb_pool_ops, SHARD_BITS, SHARDED_HASH);
+}
+
+static struct treeint_ops sharded_xt_ops = {
+    .init = sharded_xt_init,
+    .destroy = sharded_treeint_destroy,
+    .insert = sharded_treeint_insert,
+    .find = sharded_treeint_find,
+    .remove = sharded_treeint_remove,
+    .iterate = sharded_treeint_iterate,
+    .size = sharded_treeint_size,
+    .lower_bound = sharded_treeint_lower_bound,
+    .concurrent = true,
+};
+
+static struct treeint_ops sharded_rb_ops = {
+    .init = sharded_rb_init,
+    .destroy = sharded_treeint_destroy,
+    .insert = sharded_treeint_insert,
+    .find = sharded_treeint_find,
+    .remove = sharded_treeint_remove,
+    .iterate = sharded_treeint_iterate,
+    .size = sharded_treeint_size,
+    .lower_bound = sharded_treeint_lower_bound,
+    .concurrent = true,
+};
+
+#define RANGE_SPAN 100
+
+/* Hardware counters per phase, enabled with -p, see perf.h. Phases are
+ * bracketed by phase_begin() and phase_end(), which prints the counts per
+ * operation. They cover the whole phase loop, including the clock readings,
+ * one pair per batch; keys are drawn before the phase starts.
+ */
+static struct perf_counters perf;
+static bool perf_enabled;
+
+/* With make STATS=1, phases also report the tree counters of stats.h */
+#ifdef TREE_STATS
+static struct tree_counters phase_counters;
+
+static void phase_counters_print(const char *phase, size_t n)
+{
+    struct tree_counters d = tree_counters;
+
+    d.rebalances -= phase_counters.rebalances;
+    d.rebalance_steps -= phase_counters.rebalance_steps;
+    d.rotations -= phase_counters.rotations;
+    d.lookups -= phase_counters.lookups;
+    d.lookup_cmps -= phase_counters.lookup_cmps;
+    if (!n || (!d.rebalances && !d.lookups))
+        return;
+
+    printf("Tree counters per %s : rebalances %.3f, steps per rebalance "
+           "%.2f (max %llu), rotations %.3f, comparisons per lookup %.2f\n",
+           phase, (double) d.rebalances / n,
+           d.rebalances ? (double) d.rebalance_steps / d.rebalances : 0.0,
+           (unsigned long long) d.rebalance_max_steps,
+           (double) d.rotations / n,
+           d.lookups ? (double) d.lookup_cmps / d.lookups : 0.0);
+}
+#endif
+
+static inline void phase_begin(void)
+{
+#ifdef TREE_STATS
+    tree_counters.rebalance_max_steps = 0;
+    phase_counters = tree_counters;
+#endif
+    if (perf_enabled)
+        perf_start(&perf);
+}
+
+/* leave out the work between two parts of a phase */
+static inline void phase_pause(void)
+{
+    if (perf_enabled)
+        perf_pause(&perf);
+}
+
+static inline void phase_resume(void)
+{
+    if (perf_enabled)
+        perf_resume(&perf);
+}
+
+static void phase_perf_print(const char *phase, size_t n)
+{
+    struct perf_sample s;
+
+    perf_stop(&perf, &s);
+    if (!n)
+        return;
+
+    printf("Counters per %s :", phase);
+    for (int i = 0; i < PERF_NR_EVENTS; ++i) {
+        printf("%s %s ", i ? "," : "", perf_event_name(i));
+        if (s.valid[i])
+            printf("%.2f", s.value[i] / n);
+        else
+            printf("n/a");
+        if (i == PERF_INSTRUCTIONS && s.valid[PERF_CYCLES] &&
+            s.valid[PERF_INSTRUCTIONS] && s.value[PERF_CYCLES])
+            printf(" (IPC %.2f)",
+                   s.value[PERF_INSTRUCTIONS] / s.value[PERF_CYCLES]);
+    }
+    printf("\n");
+}
+
+static void phase_end(const char *phase, size_t n)
+{
+    if (perf_enabled)
+        phase_perf_print(phase, n);
+#ifdef TREE_STATS
+    phase_counters_print(phase, n);
+#endif
+}
+
+/* Depth histogram of the tree, as node counts from the root level down */
+static void print_shape(const char *when, void *ctx)
+{
+    struct tree_shape s;
+
+    ops->stats(ctx, &s);
+    printf("Depth histogram %s (height %u, average %.2f) :", when, s.height,
+           s.avg_depth);
+    for (unsigned int d = 0; d < s.height && d < TREE_SHAPE_DEPTHS; ++d)
+        printf(" %zu", s.depth[d]);
+    printf("\n");
+}
+
+/* Uniform key over the whole int range, out of two rand() calls since each
+ * provides 31 bits only.
+ */
+static inline int rand_key(void)
+{
+    return (int) (((unsigned int) rand() << 16) ^ (unsigned int) rand());
+}
+
+/* The i-th key of a phase: random with a non-zero seed, or i itself with
+ * seed 0 for the linear workload. Phases reseed the generator to replay the
+ * keys inserted, so lookups and removals hit.
+ */
+static inline int bench_key(size_t i, size_t seed)
+{
+    return seed ? rand_key() : (int) i;
+}
 
 #define bench(statement)                                                  \
     ({                                                                    \
@@ -46,88 +426,1326 @@ static struct treeint_ops rb_ops = {
         time;                                                             \
     })
 
-int main(int argc, char *argv[])
+/* Zipf exponent of the skewed phase, and the number of hottest keys whose
+ * depth it reports.
+ */
+#define ZIPF_S 0.99
+#define ZIPF_HOT 100
+
+/* Look up Zipf distributed keys in a tree holding 0 .. tree_size - 1, and
+ * report the lookup time along with the average depth of the keys accessed
+ * once the tree has adapted to the workload.
+ */
+static void bench_skewed(size_t tree_size)
 {
-    if (argc < 3) {
-        printf("usage: treeint <tree size> <seed>\n");
-        return -1;
+    struct zipf z;
+    void *ctx = ops->init();
+
+    zipf_init(&z, tree_size, ZIPF_S);
+    /* the permutation doubles as a random insertion order */
+    for (size_t i = 0; i < tree_size; ++i)
+        ops->insert(ctx, z.keys[i]);
+
+    /* warm up, letting adaptive trees reshape */
+    for (size_t i = 0; i < tree_size; ++i)
+        ops->find(ctx, zipf_next(&z));
+
+    long long find_time = 0;
+    for (size_t i = 0; i < tree_size; ++i) {
+        int v = zipf_next(&z);
+        find_time += bench(ops->find(ctx, v));
     }
+    printf("Average Zipf find time : %lf\n", (double) find_time / tree_size);
 
-    /* Add an option to specify tree implementation */
-    ops = &rb_ops;
+    long long depth = 0;
+    for (size_t i = 0; i < tree_size; ++i)
+        depth += ops->depth(ctx, zipf_next(&z));
+    printf("Average depth of Zipf keys : %lf\n", (double) depth / tree_size);
 
-    size_t tree_size = 0;
-    if (!sscanf(argv[1], "%ld", &tree_size)) {
-        printf("Invalid tree size %s\n", argv[1]);
-        return -3;
+    /* z.keys lists the keys from the hottest to the coldest */
+    size_t hot = tree_size < ZIPF_HOT ? tree_size : ZIPF_HOT;
+    depth = 0;
+    for (size_t i = 0; i < hot; ++i)
+        depth += ops->depth(ctx, z.keys[i]);
+    printf("Average depth of the %zu hottest keys : %lf\n", hot,
+           (double) depth / hot);
+
+    zipf_free(&z);
+    ops->destroy(ctx);
+}
+
+/* Multi-threaded phase: reader threads look up random keys of a tree holding
+ * 0 .. tree_size - 1 while one writer keeps inserting and removing keys
+ * outside of that range, until the readers are done.
+ */
+#define MAX_THREADS 32
+
+struct worker {
+    pthread_t thread;
+    void *ctx;
+    size_t tree_size, nr_ops;
+    size_t first, step; /* key slice of an inserter */
+    unsigned int seed;
+    atomic_bool *stop;
+};
+
+static void *reader_thread(void *arg)
+{
+    struct worker *w = arg;
+
+    for (size_t i = 0; i < w->tree_size; ++i) {
+        int v = rand_r(&w->seed) % w->tree_size;
+        void *n = ops->find(w->ctx, v);
+        assert(n);
+        (void) n;
     }
+    w->nr_ops = w->tree_size;
+    return NULL;
+}
 
-    /* Note: seed 0 is reserved as special value, it will
-     * perform linear operatoion. */
-    size_t seed = 0;
-    if (!sscanf(argv[2], "%ld", &seed)) {
-        printf("Invalid seed %s\n", argv[2]);
-        return -3;
+static void *writer_thread(void *arg)
+{
+    struct worker *w = arg;
+
+    w->nr_ops = 0;
+    while (!atomic_load(w->stop)) {
+        int v = w->tree_size + rand_r(&w->seed) % w->tree_size;
+        ops->insert(w->ctx, v);
+        ops->remove(w->ctx, v);
+        w->nr_ops += 2;
+    }
+    return NULL;
+}
+
+static void run_threads(struct worker *readers, int t, struct worker *writer)
+{
+    pthread_create(&writer->thread, NULL, writer_thread, writer);
+    for (int i = 0; i < t; ++i)
+        pthread_create(&readers[i].thread, NULL, reader_thread, &readers[i]);
+
+    for (int i = 0; i < t; ++i)
+        pthread_join(readers[i].thread, NULL);
+    atomic_store(writer->stop, true);
+    pthread_join(writer->thread, NULL);
+}
+
+static void *inserter_thread(void *arg)
+{
+    struct worker *w = arg;
+
+    for (size_t v = w->first; v < w->tree_size; v += w->step)
+        ops->insert(w->ctx, v);
+    return NULL;
+}
+
+static void run_inserters(struct worker *workers, int t)
+{
+    for (int i = 0; i < t; ++i)
+        pthread_create(&workers[i].thread, NULL, inserter_thread, &workers[i]);
+    for (int i = 0; i < t; ++i)
+        pthread_join(workers[i].thread, NULL);
+}
+
+struct iter_check {
+    size_t count;
+    int last;
+};
+
+static void iter_check_key(int key, void *arg)
+{
+    struct iter_check *c = arg;
+
+    assert(!c->count || c->last < key);
+    c->last = key;
+    c->count++;
+}
+
+/* Insert scaling: t threads fill an empty tree with 0 .. tree_size - 1, each
+ * one with its own slice of the keys.
+ */
+static void bench_insert_threads(size_t tree_size, int max_threads)
+{
+    struct worker workers[MAX_THREADS];
+
+    for (int t = 1; t <= max_threads; t *= 2) {
+        void *ctx = ops->init();
+
+        for (int i = 0; i < t; ++i) {
+            memset(&workers[i], 0, sizeof(workers[i]));
+            workers[i].ctx = ctx;
+            workers[i].tree_size = tree_size;
+            workers[i].first = i;
+            workers[i].step = t;
+        }
+
+        long long time = bench(run_inserters(workers, t));
+        printf("%d insert thread(s) : %lf inserts/us\n", t,
+               (double) tree_size * 1000 / time);
+
+        struct iter_check c = {0};
+        size_t count = ops->iterate(ctx, iter_check_key, &c);
+        assert(count == tree_size && c.count == tree_size);
+        assert(ops->size(ctx) == tree_size);
+        (void) count;
+        ops->destroy(ctx);
+    }
+}
+
+static void bench_threads(size_t tree_size)
+{
+    struct worker readers[MAX_THREADS], writer;
+    atomic_bool stop;
+    long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = nproc < 4 ? 4 : nproc > MAX_THREADS ? MAX_THREADS : nproc;
+
+    bench_insert_threads(tree_size, max_threads);
+
+    void *ctx = ops->init();
+    for (size_t i = 0; i < tree_size; ++i)
+        ops->insert(ctx, i);
+
+    for (int t = 1; t <= max_threads; t *= 2) {
+        atomic_store(&stop, false);
+        memset(&writer, 0, sizeof(writer));
+        writer.ctx = ctx;
+        writer.tree_size = tree_size;
+        writer.seed = 1;
+        writer.stop = &stop;
+        for (int i = 0; i < t; ++i) {
+            memset(&readers[i], 0, sizeof(readers[i]));
+            readers[i].ctx = ctx;
+            readers[i].tree_size = tree_size;
+            readers[i].seed = i + 2;
+        }
+
+        long long time = bench(run_threads(readers, t, &writer));
+        printf("%d reader thread(s) : %lf finds/us, %zu writes\n", t,
+               (double) t * tree_size * 1000 / time, writer.nr_ops);
     }
 
+    ops->destroy(ctx);
+}
+
+struct key_array {
+    int *keys;
+    size_t n;
+};
+
+static void key_array_push(int key, void *arg)
+{
+    struct key_array *a = arg;
+    a->keys[a->n++] = key;
+}
+
+/* Rank/select phase: random ranks are looked up through select and the keys
+ * found mapped back through rank, both checked against an in-order walk of
+ * the tree, which is what a percentile query costs without them.
+ */
+static void bench_rank_select(void *ctx, size_t tree_size)
+{
+    struct key_array a = {malloc(sizeof(int) * tree_size), 0};
+    long long walk_time, select_time = 0, rank_time = 0;
+    size_t queries = tree_size;
+    assert(a.keys);
+
+    walk_time = bench(ops->iterate(ctx, key_array_push, &a));
+    if (!a.n) {
+        free(a.keys);
+        return;
+    }
+
+    for (size_t i = 0; i < queries; ++i) {
+        size_t k = rand() % a.n, r = 0;
+        int key = 0, ret = 0;
+
+        select_time += bench(ret = ops->select(ctx, k, &key));
+        assert(!ret && key == a.keys[k]);
+        rank_time += bench(r = ops->rank(ctx, key));
+        assert(r == k);
+        (void) ret;
+        (void) r;
+    }
+    assert(ops->select(ctx, a.n, &(int){0}) == -1);
+
+    printf("In-order walk time : %lld\n", walk_time);
+    printf("Average select time : %lf\n", (double) select_time / queries);
+    printf("Average rank time : %lf\n", (double) rank_time / queries);
+    free(a.keys);
+}
+
+static size_t fill_tree(void *ctx, size_t tree_size, size_t seed)
+{
+    size_t count = 0;
+
     srand(seed);
+    for (size_t i = 0; i < tree_size; ++i)
+        count += !ops->insert(ctx, bench_key(i, seed));
+    return count;
+}
+
+/* Priority queue phase: drain the tree through pop_min and pop_max, which use
+ * the cached extremes, and through the spine walk they replace, i.e. a
+ * lower_bound from INT_MIN followed by a remove.
+ */
+static void bench_pop(size_t tree_size, size_t seed)
+{
+    long long min_time = 0, walk_time = 0, max_time = 0;
+    size_t count;
+    int key = 0, prev = 0;
 
     void *ctx = ops->init();
+    count = fill_tree(ctx, tree_size, seed);
+    for (size_t i = 0; i < count; ++i) {
+        int ret = 0;
+        min_time += bench(ret = ops->pop_min(ctx, &key));
+        assert(!ret && (!i || prev < key));
+        prev = key;
+        (void) ret;
+    }
+    assert(ops->pop_min(ctx, &key) == -1);
 
-    long long insert_time = 0;
-    for (size_t i = 0; i < tree_size; ++i) {
-        int v = seed ? rand_key(tree_size) : i;
-        insert_time += bench(ops->insert(ctx, v));
+    if (ops->lower_bound) {
+        fill_tree(ctx, tree_size, seed);
+        for (size_t i = 0; i < count; ++i) {
+            int ret = 0;
+            walk_time += bench(ret = ops->lower_bound(ctx, INT_MIN, &key);
+                               ret = ret ? ret : ops->remove(ctx, key));
+            assert(!ret && (!i || prev < key));
+            prev = key;
+            (void) ret;
+        }
     }
-    printf("Red-Black Tree\nAverage insertion time : %lf\n",
-           (double) insert_time / tree_size);
 
-    long long find_time = 0;
+    fill_tree(ctx, tree_size, seed);
+    for (size_t i = 0; i < count; ++i) {
+        int ret = 0;
+        max_time += bench(ret = ops->pop_max(ctx, &key));
+        assert(!ret && (!i || prev > key));
+        prev = key;
+        (void) ret;
+    }
+    assert(ops->pop_max(ctx, &key) == -1);
+    ops->destroy(ctx);
+
+    if (!count)
+        return;
+    printf("Average pop_min time : %lf\n", (double) min_time / count);
+    if (ops->lower_bound)
+        printf("Average pop_min time (spine walk) : %lf\n",
+               (double) walk_time / count);
+    printf("Average pop_max time : %lf\n", (double) max_time / count);
+}
+
+/* Frozen phase: the same lookups against the live tree and against its
+ * snapshot, whose answers must agree.
+ */
+static void bench_frozen(void *ctx, size_t tree_size, size_t seed)
+{
+    long long freeze_time, live_time = 0, frozen_time = 0;
+    void *frozen = NULL;
+    size_t count;
+
+    freeze_time = bench(frozen = ops->freeze(ctx));
+    assert(frozen);
+
+    count = ops->iterate(ctx, iter_check_key, &(struct iter_check){0});
+    assert(frozen_ops.iterate(frozen, iter_check_key,
+                              &(struct iter_check){0}) == count);
+    (void) count;
+
+    srand(seed);
     for (size_t i = 0; i < tree_size; ++i) {
-        int v = seed ? rand_key(tree_size) : i;
-        find_time += bench(ops->find(ctx, v));
+        int v = bench_key(i, seed);
+        void *live = NULL, *snap = NULL;
+
+        live_time += bench(live = ops->find(ctx, v));
+        frozen_time += bench(snap = frozen_ops.find(frozen, v));
+        assert(!live == !snap);
+        (void) live;
+        (void) snap;
     }
-    printf("Average find time : %lf\n", (double) find_time / tree_size);
 
-    /* Removing */
-    long long remove_time = 0;
+    printf("Freeze time : %lld\n", freeze_time);
+    printf("Average find time (live) : %lf\n", (double) live_time / tree_size);
+    printf("Average find time (frozen) : %lf\n",
+           (double) frozen_time / tree_size);
+    frozen_ops.destroy(frozen);
+}
+
+/* Snapshot phase: freeze the tree to a file, drop it from the page cache and
+ * map it back. The mapped snapshot serves lookups in place, or refills a tree
+ * through its bulk load, which is compared with inserting the keys again.
+ */
+static void bench_snapshot(void *ctx, size_t tree_size, size_t seed)
+{
+    char path[] = "/tmp/treeint-XXXXXX";
+    long long save_time, open_time, mapped_time = 0, build_time, insert_time;
+    struct key_array a;
+    struct snap *sn = NULL;
+    int ret = 0, fd = mkstemp(path);
+    assert(fd >= 0);
+
+    struct eyt_set *frozen = ops->freeze(ctx);
+    assert(frozen);
+    save_time = bench(ret = snap_save(path, frozen));
+    assert(!ret);
+    frozen_ops.destroy(frozen);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    open_time = bench(sn = snap_open(path));
+    assert(sn);
+    srand(seed);
     for (size_t i = 0; i < tree_size; ++i) {
-        int v = seed ? rand_key(tree_size) : i;
-        remove_time += bench(ops->remove(ctx, v));
+        int v = bench_key(i, seed);
+        void *n = NULL;
+        mapped_time += bench(n = frozen_ops.find(sn, v));
+        assert(!n == !ops->find(ctx, v));
+        (void) n;
     }
-    printf("Average remove time : %lf\n", (double) remove_time / tree_size);
+
+    /* keys come out of the snapshot sorted, ready for the bulk load */
+    a.keys = malloc(sizeof(int) * (sn->set.n ? sn->set.n : 1));
+    a.n = 0;
+    assert(a.keys);
+    void *tree = ops->init();
+    build_time = bench(frozen_ops.iterate(sn, key_array_push, &a);
+                       ret = ops->build(tree, a.keys, a.n));
+    assert(!ret);
+    ops->destroy(tree);
+    (void) ret;
+
+    /* the restart path without a snapshot: replay the inserts in their
+     * original order, not the sorted one, which is the cheapest to insert
+     */
+    int *order = malloc(sizeof(int) * (tree_size ? tree_size : 1));
+    assert(order);
+    srand(seed);
+    for (size_t i = 0; i < tree_size; ++i)
+        order[i] = bench_key(i, seed);
+    tree = ops->init();
+    insert_time = bench(for (size_t i = 0; i < tree_size; ++i)
+                            ops->insert(tree, order[i]));
+    assert(ops->size(tree) == a.n);
+    ops->destroy(tree);
+    free(order);
+
+    printf("Snapshot save time : %lld (%zu keys)\n", save_time, a.n);
+    printf("Snapshot open time : %lld\n", open_time);
+    printf("Average find time (mapped) : %lf\n",
+           (double) mapped_time / tree_size);
+    printf("Load time (bulk build from snapshot) : %lld\n", build_time);
+    printf("Load time (reinsert) : %lld\n", insert_time);
+
+    free(a.keys);
+    snap_close(sn);
+    unlink(path);
+}
+
+static int key_cmp(const void *a, const void *b)
+{
+    return cmp_int(*(const int *) a, *(const int *) b);
+}
+
+/* Compare iteration and lower_bound of the tree against a sorted copy of
+ * the keys in @ref, whose duplicates must have been dropped.
+ */
+static void check_against(void *ctx, const int *ref, size_t n)
+{
+    struct key_array a = {malloc(sizeof(int) * (n + 1)), 0};
+    unsigned int seed = 3;
+    assert(a.keys);
+
+    size_t count = ops->iterate(ctx, key_array_push, &a);
+    assert(count == n && a.n == n && ops->size(ctx) == n);
+    assert(!memcmp(a.keys, ref, sizeof(int) * n));
+    (void) count;
+
+    for (size_t i = 0; i < 2 * n + 2; ++i) {
+        /* probe every key, just around it, and random values */
+        int probe = i < n           ? ref[i]
+                    : i < 2 * n     ? ref[i - n] + (ref[i - n] < INT_MAX)
+                    : i == 2 * n    ? INT_MIN
+                                    : (int) (((unsigned int) rand_r(&seed)
+                                              << 16) ^ rand_r(&seed));
+        const int *lb = ref, *end = ref + n;
+        int key = 0, ret = ops->lower_bound(ctx, probe, &key);
+
+        for (size_t len = n; len;) {
+            size_t half = len / 2;
+            if (lb[half] < probe) {
+                lb += half + 1;
+                len -= half + 1;
+            } else {
+                len = half;
+            }
+        }
+        assert(lb == end ? ret == -1 : !ret && key == *lb);
+        (void) ret;
+        (void) end;
+    }
+    free(a.keys);
+}
+
+/* Full-range check: random keys over the whole int range, plus the extremes
+ * and the values around zero, where a subtracting comparator goes wrong.
+ * Iteration and lower_bound must agree with a sorted reference, before and
+ * after removing half of the keys.
+ */
+#define FULL_RANGE_KEYS (1 << 14)
+
+static void check_full_range(void)
+{
+    static const int edges[] = {INT_MIN, INT_MIN + 1, -1, 0, 1,
+                                INT_MAX - 1, INT_MAX};
+    size_t nedges = sizeof(edges) / sizeof(edges[0]);
+    size_t total = FULL_RANGE_KEYS + nedges, n = 0;
+    int *ref = malloc(sizeof(int) * total);
+    unsigned int seed = 4;
+    void *ctx = ops->init();
+    assert(ref);
+
+    for (size_t i = 0; i < total; ++i) {
+        int key = i < nedges
+                      ? edges[i]
+                      : (int) (((unsigned int) rand_r(&seed) << 16) ^
+                               rand_r(&seed));
+        ops->insert(ctx, key);
+        ref[i] = key;
+    }
+    qsort(ref, total, sizeof(int), key_cmp);
+    for (size_t i = 0; i < total; ++i)
+        if (!n || ref[n - 1] != ref[i])
+            ref[n++] = ref[i];
+    check_against(ctx, ref, n);
+
+    /* drop every other key, the extremes included */
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (i & 1)
+            ref[kept++] = ref[i];
+        else
+            ops->remove(ctx, ref[i]);
+    }
+    check_against(ctx, ref, kept);
+
+    ops->destroy(ctx);
+    free(ref);
+}
+
+/* Mixed phase, see struct bench_mix. The operations are drawn before the
+ * clock starts, then run in batches of mix.batch between two clock readings.
+ * The first mix.warmup operations are not timed, letting caches fill and
+ * adaptive trees reshape; every repetition then runs mix.ops operations on
+ * the same tree.
+ */
+enum { MIX_FIND, MIX_INSERT, MIX_REMOVE };
+
+struct mix_op {
+    int key;
+    int type;
+};
+
+static struct bench_mix mix = {
+    .read_pct = 90,
+    .dist = BENCH_UNIFORM,
+    .zipf_s = ZIPF_S,
+    .reps = 5,
+    .batch = 16,
+};
+static struct bench_out out;
+static bool out_enabled;
+static double timer_ns;
+
+/* Rank r of a key domain of @domain keys, spread evenly over the whole int
+ * range in rank order, so that sequential ranks are ascending keys. Flipping
+ * the top bit maps the unsigned order onto the signed one.
+ */
+static inline int mix_key(size_t r, size_t domain)
+{
+    uint64_t stride = (1ULL << 32) / domain;
+    return (int) ((uint32_t) (r * stride) ^ 0x80000000U);
+}
+
+static void mix_draw(struct mix_op *op, size_t n, size_t domain,
+                     struct zipf *z, size_t *next)
+{
+    for (size_t i = 0; i < n; ++i) {
+        size_t r;
+        unsigned int dice = rand() % 200;
+
+        switch (mix.dist) {
+        case BENCH_ZIPF:
+            r = zipf_next(z);
+            break;
+        case BENCH_SEQUENTIAL:
+            r = (*next)++ % domain;
+            break;
+        default:
+            r = (unsigned int) rand_key() % domain;
+            break;
+        }
+        op[i].key = mix_key(r, domain);
+        op[i].type = dice < 2 * mix.read_pct ? MIX_FIND
+                     : dice & 1              ? MIX_INSERT
+                                             : MIX_REMOVE;
+    }
+}
+
+static inline void mix_run(void *ctx, const struct mix_op *op)
+{
+    switch (op->type) {
+    case MIX_FIND:
+        ops->find(ctx, op->key);
+        break;
+    case MIX_INSERT:
+        ops->insert(ctx, op->key);
+        break;
+    default:
+        ops->remove(ctx, op->key);
+        break;
+    }
+}
+
+static void bench_mixed(const char *name, size_t tree_size, size_t seed)
+{
+    size_t domain = 2 * tree_size, next = 0, n = mix.ops, warmup = mix.warmup;
+    struct mix_op *op = malloc(sizeof(*op) * n);
+    struct bench_hist *h = malloc(sizeof(*h));
+    struct bench_result r = {.tree_size = tree_size, .timer_ns = timer_ns};
+    double sum = 0, sq = 0;
+    struct zipf z;
+    void *ctx = ops->init();
+    assert(op && h);
+
+    srand(seed);
+    if (mix.dist == BENCH_ZIPF)
+        zipf_init(&z, domain, mix.zipf_s);
+    for (size_t i = 0; i < domain; i += 2)
+        ops->insert(ctx, mix_key(i, domain));
+
+    while (warmup) {
+        size_t chunk = warmup < n ? warmup : n;
+        mix_draw(op, chunk, domain, &z, &next);
+        for (size_t i = 0; i < chunk; ++i)
+            mix_run(ctx, &op[i]);
+        warmup -= chunk;
+    }
+
+    bench_hist_reset(h);
+    phase_begin();
+    for (unsigned int rep = 0; rep < mix.reps; ++rep) {
+        double rep_ns = 0;
+
+        phase_pause();
+        mix_draw(op, n, domain, &z, &next);
+        phase_resume();
+        for (size_t i = 0; i < n; i += mix.batch) {
+            size_t end = i + mix.batch < n ? i + mix.batch : n;
+            long long t = bench_now();
+            for (size_t j = i; j < end; ++j)
+                mix_run(ctx, &op[j]);
+            double ns = bench_now() - t - timer_ns;
+            bench_hist_add(h, ns / (end - i), end - i);
+            rep_ns += ns > 0 ? ns : 0;
+        }
+        double mops = rep_ns ? n / rep_ns * 1000 : 0;
+        sum += mops;
+        sq += mops * mops;
+    }
+
+    r.mops = sum / mix.reps;
+    r.mops_sd = sqrt(fmax(sq / mix.reps - r.mops * r.mops, 0));
+    r.mean_ns = h->count ? h->sum / h->count : 0;
+    r.batch_p50_ns = bench_hist_percentile(h, 0.5);
+    r.batch_p99_ns = bench_hist_percentile(h, 0.99);
+    r.batch_p999_ns = bench_hist_percentile(h, 0.999);
+    r.batch_max_ns = h->max;
+    printf("Mixed workload (%u%% reads, %s keys) : %lf ops/us (sd %lf)\n",
+           mix.read_pct, bench_dist_name(mix.dist), r.mops, r.mops_sd);
+    if (mix.batch == 1)
+        printf("Mixed workload latency mean/p50/p99/p99.9 : ");
+    else
+        printf("Mixed workload time per operation, mean and p50/p99/p99.9 "
+               "of %u-operation batch means : ", mix.batch);
+    printf("%.1f/%.1f/%.1f/%.1f ns\n", r.mean_ns, r.batch_p50_ns,
+           r.batch_p99_ns, r.batch_p999_ns);
+    phase_end("mixed operation", (size_t) mix.reps * n);
+    if (out_enabled)
+        bench_out_record(&out, name, &mix, &r);
+
+    if (mix.dist == BENCH_ZIPF)
+        zipf_free(&z);
+    ops->destroy(ctx);
+    free(h);
+    free(op);
+}
+
+/* Keys of the phase run by run_phase(), drawn before it starts, and the
+ * number of its operations that hit.
+ */
+static const int *phase_keys;
+static size_t phase_hits;
+
+/* bench_key() for i in 0 .. n - 1, from a freshly seeded generator */
+static int *draw_keys(size_t n, size_t seed)
+{
+    int *keys = malloc(sizeof(int) * (n ? n : 1));
+    assert(keys);
+
+    srand(seed);
+    for (size_t i = 0; i < n; ++i)
+        keys[i] = bench_key(i, seed);
+    return keys;
+}
+
+static void set_insert(void *ctx, size_t i)
+{
+    phase_hits += !ops->insert(ctx, phase_keys[i]);
+}
+
+static void set_find(void *ctx, size_t i)
+{
+    phase_hits += !!ops->find(ctx, phase_keys[i]);
+}
+
+static void set_remove(void *ctx, size_t i)
+{
+    phase_hits += !ops->remove(ctx, phase_keys[i]);
+}
+
+/* Run @op on the @n keys of phase_keys with the batched harness: the clock
+ * is read once per mix.batch operations, and the calibrated cost of reading
+ * it is subtracted. Prints the average time of an operation, followed by
+ * @label, then the counters of the phase. Returns the number of operations
+ * that changed the set or found their key.
+ */
+static size_t run_phase(void *ctx,
+                        void (*op)(void *, size_t),
+                        size_t n,
+                        const char *what,
+                        const char *phase,
+                        const char *label)
+{
+    double total = 0;
+
+    phase_hits = 0;
+    phase_begin();
+    for (size_t i = 0; i < n; i += mix.batch) {
+        size_t end = i + mix.batch < n ? i + mix.batch : n;
+        long long t = bench_now();
+        for (size_t j = i; j < end; ++j)
+            op(ctx, j);
+        double ns = bench_now() - t - timer_ns;
+        total += ns > 0 ? ns : 0;
+    }
+    printf("Average %s time%s : %lf\n", what, label, n ? total / n : 0.0);
+    phase_end(phase, n);
+    return phase_hits;
+}
+
+/* Sweep the imbalance tolerance from strict to loose: each setting gets a
+ * fresh tree and the same keys, inserted, looked up and removed. Looser trees
+ * are deeper, which the find time and the height show, and rotate less, which
+ * the tree counters of a make STATS=1 build show.
+ */
+static const int balance_sweep[] = {1, 2, 3, 4, 6, 8};
+
+static void bench_balance(size_t tree_size, size_t seed)
+{
+    int *keys = draw_keys(tree_size, seed);
+
+    phase_keys = keys;
+    for (size_t b = 0; b < sizeof(balance_sweep) / sizeof(int); ++b) {
+        int balance = balance_sweep[b], ret;
+        void *ctx = ops->init();
+        char label[32];
+
+        ret = ops->balance(ctx, balance);
+        assert(!ret);
+        (void) ret;
+        snprintf(label, sizeof(label), " (balance %d)", balance);
+
+        run_phase(ctx, set_insert, tree_size, "insertion", "insert", label);
+        if (ops->height) {
+            double avg;
+            int height = ops->height(ctx, &avg);
+            printf("Tree height%s : %d (average depth %lf)\n", label, height,
+                   avg);
+        }
+        run_phase(ctx, set_find, tree_size, "find", "find", label);
+        run_phase(ctx, set_remove, tree_size, "remove", "remove", label);
+        assert(!ops->size(ctx));
+
+        ops->destroy(ctx);
+    }
+    free(keys);
+}
+
+/* Run the insert/find/remove phases against the tree behind @ops. The random
+ * generator is reseeded so that every tree sees the same key sequence.
+ */
+static void bench_tree(const char *name, size_t tree_size, size_t seed)
+{
+    if (ops->lower_bound)
+        check_full_range();
+
+    int *keys = draw_keys(tree_size, seed);
+    void *ctx = ops->init();
+
+    phase_keys = keys;
+
+    printf("%s\n", name);
+    size_t inserted =
+        run_phase(ctx, set_insert, tree_size, "insertion", "insert", "");
+    assert(ops->size(ctx) == inserted);
+
+    if (ops->height) {
+        double avg;
+        int height = ops->height(ctx, &avg);
+        printf("Tree height after insertion : %d (average depth %lf)\n",
+               height, avg);
+    }
+    if (ops->stats)
+        print_shape("after insertion", ctx);
+
+    if (ops->rebalance) {
+        long long rebalance_time = bench(ops->rebalance(ctx));
+        printf("Rebalance time : %lld\n", rebalance_time);
+        if (ops->height) {
+            double avg;
+            int height = ops->height(ctx, &avg);
+            printf("Tree height after rebalance : %d (average depth %lf)\n",
+                   height, avg);
+        }
+        if (ops->stats)
+            print_shape("after rebalance", ctx);
+    }
+
+    size_t found = run_phase(ctx, set_find, tree_size, "find", "find", "");
+    assert(found == tree_size);
+    (void) found;
+
+    if (ops->freeze)
+        bench_frozen(ctx, tree_size, seed);
+
+    if (ops->freeze && ops->build)
+        bench_snapshot(ctx, tree_size, seed);
+
+    if (ops->find_batch) {
+        /* Time the whole key set at once, both one lookup after the other
+         * and through the batched interface, on the same keys.
+         */
+        void **res = malloc(sizeof(void *) * tree_size);
+        assert(res);
+
+        long long serial_time = bench({
+            for (size_t i = 0; i < tree_size; ++i)
+                res[i] = ops->find(ctx, keys[i]);
+        });
+        long long batch_time =
+            bench(ops->find_batch(ctx, keys, tree_size, res));
+        printf("Average find time (serial) : %lf\n",
+               (serial_time - timer_ns) / tree_size);
+        printf("Average find time (batched) : %lf\n",
+               (batch_time - timer_ns) / tree_size);
+
+        for (size_t i = 0; i < tree_size; ++i)
+            assert(res[i] == ops->find(ctx, keys[i]));
+        free(res);
+    }
+
+    if (ops->range) {
+        /* Scan windows holding about RANGE_SPAN keys, starting at inserted
+         * ones: random keys are spread over the whole int range.
+         */
+        size_t scans = tree_size / RANGE_SPAN + 1, visited = 0;
+        long long span = seed ? RANGE_SPAN * (4294967296.0 / tree_size)
+                              : RANGE_SPAN;
+        double range_time = 0;
+        srand(seed);
+        for (size_t i = 0; i < scans; ++i) {
+            int lo = seed ? rand_key() : (int) (i * RANGE_SPAN);
+            int hi = lo + span - 1 > INT_MAX ? INT_MAX : lo + span - 1;
+            long long t = bench(visited += ops->range(ctx, lo, hi));
+            range_time += t - timer_ns;
+        }
+        printf("Average range scan time per key : %lf\n",
+               visited ? range_time / visited : 0.0);
+    }
+
+    struct iter_check c = {0};
+    size_t count = 0;
+    phase_begin();
+    long long iter_time = bench(count = ops->iterate(ctx, iter_check_key, &c));
+    assert(count == c.count && count == inserted);
+    printf("Average iteration time per key : %lf\n",
+           count ? (double) iter_time / count : 0.0);
+    phase_end("key iterated", count);
+
+    if (ops->rank && ops->select)
+        bench_rank_select(ctx, tree_size);
+
+    size_t removed =
+        run_phase(ctx, set_remove, tree_size, "remove", "remove", "");
+    assert(removed == inserted && !ops->size(ctx));
+    (void) inserted;
+    (void) removed;
+
+    ops->destroy(ctx);
+
+    if (ops->build) {
+        /* rehydrate the keys 0 .. tree_size - 1 in one go */
+        for (size_t i = 0; i < tree_size; ++i)
+            keys[i] = i;
+
+        ctx = ops->init();
+        long long build_time = bench(ops->build(ctx, keys, tree_size));
+        printf("Average bulk load time : %lf\n",
+               (double) build_time / tree_size);
+
+        for (size_t i = 0; i < tree_size; ++i)
+            assert(ops->find(ctx, keys[i]));
+        assert(ops->size(ctx) == tree_size);
+
+        ops->destroy(ctx);
+    }
+    free(keys);
+
+    if (ops->pop_min && ops->pop_max)
+        bench_pop(tree_size, seed);
+
+    if (ops->depth && tree_size)
+        bench_skewed(tree_size);
+
+    if (ops->balance)
+        bench_balance(tree_size, seed);
+
+    if (mix.reps && mix.ops)
+        bench_mixed(name, tree_size, seed);
+
+    if (ops->concurrent && tree_size)
+        bench_threads(tree_size);
     printf("\n");
+}
 
+/* Interval phase: tree_size intervals of random length below INTERVAL_SPAN,
+ * queried with random windows (every other one a single point, i.e. a
+ * stabbing query). The first INTERVAL_SCANS queries are also answered by a
+ * linear scan of all the intervals, which must agree with the tree.
+ */
+#define INTERVAL_SPAN 100
+#define INTERVAL_SCANS 100
 
-    /* Red-black tree */
-    ops = &xt_ops;
+static size_t interval_scan(const struct interval_node *nodes,
+                            size_t n,
+                            int start,
+                            int last)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < n; ++i)
+        count += nodes[i].start <= last && start <= nodes[i].last;
+    return count;
+}
+
+static void bench_intervals(const char *name, size_t tree_size, size_t seed)
+{
+    struct interval_node *nodes = malloc(sizeof(*nodes) * tree_size);
+    struct interval_tree tree;
+    long long insert_time = 0, query_time = 0, scan_time = 0, remove_time = 0;
+    size_t scans = 0, hits = 0;
+    assert(nodes);
 
-    ctx = ops->init();
+    srand(seed);
+    interval_tree_init(&tree);
 
-    insert_time = 0;
     for (size_t i = 0; i < tree_size; ++i) {
-        int v = seed ? rand_key(tree_size) : i;
-        insert_time += bench(ops->insert(ctx, v));
+        nodes[i].start = seed ? rand() % tree_size : i;
+        nodes[i].last = nodes[i].start + rand() % INTERVAL_SPAN;
+        insert_time += bench(interval_tree_insert(&tree, &nodes[i]));
     }
-    printf("XTree\nAverage insertion time : %lf\n",
-           (double) insert_time / tree_size);
 
-    find_time = 0;
     for (size_t i = 0; i < tree_size; ++i) {
-        int v = seed ? rand_key(tree_size) : i;
-        find_time += bench(ops->find(ctx, v));
+        int start = rand() % tree_size;
+        int last = i % 2 ? start + rand() % INTERVAL_SPAN : start;
+        size_t count = 0;
+
+        query_time +=
+            bench(count = interval_tree_overlap(&tree, start, last, NULL, NULL));
+        hits += count;
+        if (scans < INTERVAL_SCANS) {
+            size_t expected = 0;
+            scan_time +=
+                bench(expected = interval_scan(nodes, tree_size, start, last));
+            assert(count == expected);
+            (void) expected;
+            scans++;
+        }
     }
-    printf("Average find time : %lf\n", (double) find_time / tree_size);
 
-    remove_time = 0;
-    for (size_t i = 0; i < tree_size; ++i) {
-        int v = seed ? rand_key(tree_size) : i;
-        remove_time += bench(ops->remove(ctx, v));
+    for (size_t i = 0; i < tree_size; ++i)
+        remove_time += bench(interval_tree_remove(&tree, &nodes[i]));
+    assert(!tree.count && RB_EMPTY_ROOT(&tree.root));
+
+    printf("%s\nAverage insertion time : %lf\n", name,
+           (double) insert_time / tree_size);
+    printf("Average overlap query time : %lf (%lf hits)\n",
+           (double) query_time / tree_size, (double) hits / tree_size);
+    printf("Average linear scan time : %lf\n",
+           scans ? (double) scan_time / scans : 0.0);
+    printf("Average remove time : %lf\n\n", (double) remove_time / tree_size);
+    free(nodes);
+}
+
+/* Key/value phases: the benchmark keys are spread over the 64-bit range by
+ * a multiplicative bijection, and each one maps to a KV_VALUE_SIZE value
+ * derived from it, which find must return intact.
+ */
+#define KV_VALUE_SIZE 16
+#define kv_key(v) ((int64_t) ((uint64_t) (v) * 0x9E3779B97F4A7C15ULL))
+
+struct kv_value {
+    int64_t key, check;
+};
+
+_Static_assert(sizeof(struct kv_value) == KV_VALUE_SIZE, "kv value size");
+
+static bool kv_value_ok(const void *p, int64_t key)
+{
+    const struct kv_value *v = p;
+    return v && v->key == key && v->check == ~key;
+}
+
+static struct treeint_kv_ops *kv;
+
+static void kv_insert(void *ctx, size_t i)
+{
+    int64_t key = kv_key(phase_keys[i]);
+    struct kv_value v = {key, ~key};
+
+    phase_hits += !kv->insert(ctx, key, &v);
+}
+
+static void kv_find(void *ctx, size_t i)
+{
+    phase_hits += !!kv->find(ctx, kv_key(phase_keys[i]));
+}
+
+static void kv_remove(void *ctx, size_t i)
+{
+    phase_hits += !kv->remove(ctx, kv_key(phase_keys[i]));
+}
+
+/* The insert, find and remove phases against the map behind @kv */
+static void bench_kv(const char *name, size_t tree_size, size_t seed)
+{
+    int *keys = draw_keys(tree_size, seed);
+    void *ctx = kv->init(KV_VALUE_SIZE);
+
+    phase_keys = keys;
+    printf("%s\n", name);
+    size_t inserted =
+        run_phase(ctx, kv_insert, tree_size, "insertion", "insert", "");
+
+    /* look up and remove the very keys inserted */
+    size_t found = run_phase(ctx, kv_find, tree_size, "find", "find", "");
+    assert(found == tree_size);
+    for (size_t i = 0; i < tree_size; ++i)
+        assert(kv_value_ok(kv->find(ctx, kv_key(keys[i])), kv_key(keys[i])));
+
+    size_t removed =
+        run_phase(ctx, kv_remove, tree_size, "remove", "remove", "");
+    assert(removed == inserted);
+    for (size_t i = 0; i < tree_size; ++i)
+        assert(!kv->find(ctx, kv_key(keys[i])));
+    (void) inserted;
+    (void) found;
+    (void) removed;
+    printf("\n");
+
+    kv->destroy(ctx);
+    free(keys);
+}
+
+/* Teardown run (-T): a degenerate chain of tree_size nodes, built without
+ * searching, then destroyed. A recursive teardown would need a stack frame
+ * per node, so this is the run that catches one.
+ */
+static bool teardown;
+
+static void bench_teardown(const char *name, size_t tree_size)
+{
+    void *ctx = ops->init();
+    int ret = 0;
+
+    long long chain_time = bench(ret = ops->chain(ctx, tree_size));
+    assert(!ret && ops->size(ctx) == tree_size);
+    (void) ret;
+    printf("%s\nAverage chain link time : %lf\n", name,
+           (double) chain_time / tree_size);
+    if (ops->height)
+        printf("Tree height : %d\n", ops->height(ctx, NULL));
+
+    long long destroy_time = bench(ops->destroy(ctx));
+    printf("Average teardown time : %lf\n\n",
+           (double) destroy_time / tree_size);
+}
+
+/* Every backend treeint knows, in the order of the default run. Integer
+ * sets go through bench_tree(), maps through bench_kv(), and the entry with
+ * neither is the interval tree.
+ */
+struct backend {
+    const char *name; /* command-line name */
+    const char *title;
+    struct treeint_ops *ops;
+    struct treeint_kv_ops *kv_ops;
+};
+
+static const struct backend backends[] = {
+    {"rb", "Red-Black Tree", &rb_ops, NULL},
+    {"rb-pool", "Red-Black Tree (node pool)", &rb_pool_ops, NULL},
+    {"rb-os", "Red-Black Tree (order statistics)", &rb_os_ops, NULL},
+    {"rb-rcu", "Red-Black Tree (lock-free readers)", &rb_rcu_ops, NULL},
+    {"bp", "B+Tree", &bp_ops, NULL},
+    {"xt", "XTree", &xt_ops, NULL},
+    {"xt-pool", "XTree (node pool)", &xt_pool_ops, NULL},
+    {"xt-deferred", "XTree (deferred update)", &xt_deferred_ops, NULL},
+    {"xt-manual", "XTree (manual rebalance)", &xt_manual_ops, NULL},
+    {"xt-promote", "XTree (promote on find)", &xt_promote_ops, NULL},
+    {"xt-mutex", "XTree (mutex)", &xt_locked_ops, NULL},
+    {"xt-rcu", "XTree (lock-free readers)", &xt_rcu_ops, NULL},
+    {"sharded-xt", "Sharded XTree", &sharded_xt_ops, NULL},
+    {"sharded-rb", "Sharded Red-Black Tree", &sharded_rb_ops, NULL},
+    {"xt-inline", "XTree (inlined comparator)", &xt_inline_ops, NULL},
+    {"xti", "XTree (compact int)", &xti_ops, NULL},
+    {"kv-xt", "XTree (64-bit key/value)", NULL, &xt_kv_ops},
+    {"kv-rb", "Red-Black Tree (64-bit key/value)", NULL, &rb_kv_ops},
+    {"interval", "Interval Tree", NULL, NULL},
+};
+
+#define NR_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+/* Name of the first required hook @b lacks, NULL when it has them all */
+static const char *backend_missing(const struct backend *b)
+{
+    if (b->ops) {
+        const struct treeint_ops *o = b->ops;
+        return !o->init      ? "init"
+               : !o->destroy ? "destroy"
+               : !o->insert  ? "insert"
+               : !o->find    ? "find"
+               : !o->remove  ? "remove"
+               : !o->iterate ? "iterate"
+               : !o->size    ? "size"
+                             : NULL;
+    }
+    if (b->kv_ops) {
+        const struct treeint_kv_ops *o = b->kv_ops;
+        return !o->init      ? "init"
+               : !o->destroy ? "destroy"
+               : !o->insert  ? "insert"
+               : !o->find    ? "find"
+               : !o->remove  ? "remove"
+                             : NULL;
     }
-    printf("Average remove time : %lf\n", (double) remove_time / tree_size);
+    return NULL;
+}
 
-    ops->destroy(ctx);
+static int backend_lookup(const char *name)
+{
+    for (size_t i = 0; i < NR_BACKENDS; ++i) {
+        if (!strcmp(backends[i].name, name))
+            return i;
+    }
+    return -1;
+}
+
+static void run_backend(const struct backend *b, size_t tree_size, size_t seed)
+{
+    if (teardown) {
+        if (b->ops && b->ops->chain) {
+            ops = b->ops;
+            bench_teardown(b->title, tree_size);
+        }
+        return;
+    }
+
+    if (b->ops) {
+        ops = b->ops;
+        bench_tree(b->title, tree_size, seed);
+    } else if (b->kv_ops) {
+        kv = b->kv_ops;
+        bench_kv(b->title, tree_size, seed);
+    } else {
+        bench_intervals(b->title, tree_size, seed);
+    }
+}
+
+static void usage(void)
+{
+    printf("usage: treeint [options] <tree size> <seed>\n"
+           "  -b <name>  run this backend only, may be repeated or given a\n"
+           "             comma separated list (all of them)\n"
+           "  -l         list the backends\n"
+           "  -p         count cycles, instructions, cache, branch and TLB\n"
+           "             misses per phase\n"
+           "  -T         teardown run only: destroy a degenerate tree of\n"
+           "             <tree size> nodes, with the backends that can link one\n"
+           "mixed workload options:\n"
+           "  -r <pct>   share of reads, the rest are inserts and removes "
+           "(90)\n"
+           "  -k <dist>  keys: uniform, zipf or sequential (uniform)\n"
+           "  -s <s>     Zipf exponent (%g)\n"
+           "  -n <ops>   timed operations per repetition (tree size)\n"
+           "  -w <ops>   warm-up operations (tree size)\n"
+           "  -R <reps>  repetitions, 0 skips the workload (5)\n"
+           "  -B <ops>   operations per clock reading, percentiles are of\n"
+           "             batch means unless 1 (16)\n"
+           "  -f <fmt>   record format: csv or json (csv)\n"
+           "  -o <file>  write a record per tree to <file>, - for stdout\n",
+           ZIPF_S);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out_path = NULL;
+    enum bench_format format = BENCH_CSV;
+    bool warmup_set = false, selected[NR_BACKENDS] = {false};
+    size_t nr_selected = 0;
+    int opt;
+
+    for (size_t i = 0; i < NR_BACKENDS; ++i) {
+        const char *hook = backend_missing(&backends[i]);
+        if (hook) {
+            printf("Backend %s lacks %s\n", backends[i].name, hook);
+            return -2;
+        }
+    }
+
+    while ((opt = getopt(argc, argv, "b:lpTr:k:s:n:w:R:B:f:o:")) != -1) {
+        switch (opt) {
+        case 'b':
+            for (char *name = strtok(optarg, ","); name;
+                 name = strtok(NULL, ",")) {
+                int i = backend_lookup(name);
+                if (i < 0) {
+                    printf("Unknown backend %s, see -l\n", name);
+                    return -3;
+                }
+                nr_selected += !selected[i];
+                selected[i] = true;
+            }
+            break;
+        case 'l':
+            for (size_t i = 0; i < NR_BACKENDS; ++i)
+                printf("%-12s %s\n", backends[i].name, backends[i].title);
+            return 0;
+        case 'p':
+            perf_enabled = true;
+            break;
+        case 'T':
+            teardown = true;
+            break;
+        case 'r':
+            mix.read_pct = atoi(optarg);
+            if (mix.read_pct > 100) {
+                printf("Invalid read share %s\n", optarg);
+                return -3;
+            }
+            break;
+        case 'k':
+            if (bench_dist_parse(optarg, &mix.dist)) {
+                printf("Invalid key distribution %s\n", optarg);
+                return -3;
+            }
+            break;
+        case 's':
+            mix.zipf_s = atof(optarg);
+            break;
+        case 'n':
+            mix.ops = strtoull(optarg, NULL, 0);
+            break;
+        case 'w':
+            mix.warmup = strtoull(optarg, NULL, 0);
+            warmup_set = true;
+            break;
+        case 'R':
+            mix.reps = atoi(optarg);
+            break;
+        case 'B':
+            mix.batch = atoi(optarg);
+            if (!mix.batch) {
+                printf("Invalid batch size %s\n", optarg);
+                return -3;
+            }
+            break;
+        case 'f':
+            if (!strcmp(optarg, "csv")) {
+                format = BENCH_CSV;
+            } else if (!strcmp(optarg, "json")) {
+                format = BENCH_JSON;
+            } else {
+                printf("Invalid format %s\n", optarg);
+                return -3;
+            }
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            usage();
+            return -1;
+        }
+    }
 
+    if (argc - optind < 2) {
+        usage();
+        return -1;
+    }
+
+    size_t tree_size = 0;
+    if (!sscanf(argv[optind], "%ld", &tree_size)) {
+        printf("Invalid tree size %s\n", argv[optind]);
+        return -3;
+    }
+
+    /* Note: seed 0 is reserved as special value, it will
+     * perform linear operatoion. */
+    size_t seed = 0;
+    if (!sscanf(argv[optind + 1], "%ld", &seed)) {
+        printf("Invalid seed %s\n", argv[optind + 1]);
+        return -3;
+    }
+
+    if (!mix.ops)
+        mix.ops = tree_size;
+    if (!warmup_set)
+        mix.warmup = tree_size;
+    if (out_path) {
+        if (bench_out_open(&out, out_path, format)) {
+            printf("Cannot open %s\n", out_path);
+            return -2;
+        }
+        out_enabled = true;
+    }
+    if (perf_enabled && !perf_open(&perf)) {
+        printf("No hardware counter available, see perf_event_paranoid\n");
+        perf_enabled = false;
+    }
+    timer_ns = bench_calibrate();
+    printf("Timer overhead : %.1f ns\n\n", timer_ns);
+
+    for (size_t i = 0; i < NR_BACKENDS; ++i) {
+        if (!nr_selected || selected[i])
+            run_backend(&backends[i], tree_size, seed);
+    }
 
+    if (out_enabled)
+        bench_out_close(&out);
+    if (perf_enabled)
+        perf_close(&perf);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct tree_shape;
+
+/* Integer set interface implemented by every tree benchmarked in treeint.
+ *
+ * The first hooks are required, treeint refuses a backend lacking any of
+ * them: insert and remove return 0 when the set changed and -1 otherwise,
+ * find returns NULL for a missing key, iterate passes every key to the
+ * callback in ascending order and returns their number, and size returns
+ * the number of keys. Callers only test the result of find against NULL,
+ * which lets the lock-free backends return a token that outlives the entry.
+ */
+struct treeint_ops {
+    void *(*init)();
+    int (*destroy)(void *);
+    int (*insert)(void *, int);
+    void *(*find)(void *, int);
+    int (*remove)(void *, int);
+    size_t (*iterate)(void *, void (*)(int, void *), void *);
+    size_t (*size)(void *);
+    int (*build)(void *, const int *, size_t); /* optional bulk load */
+    void (*find_batch)(void *, const int *, size_t, void **); /* optional */
+    size_t (*range)(void *, int, int); /* optional: keys in [lo, hi] */
+    int (*rebalance)(void *); /* optional: run after the insert phase */
+    /* optional: fill an empty tree with the keys 0 .. n - 1 as a degenerate
+     * chain, for the teardown run
+     */
+    int (*chain)(void *, size_t);
+    int (*height)(void *, double *); /* optional: levels, average depth */
+    int (*depth)(void *, int);       /* optional: depth of a key */
+    int (*stats)(void *, struct tree_shape *); /* optional, see stats.h */
+    /* optional: set the imbalance tolerated before rotating, 1 being the
+     * strictest, on an empty tree; returns -1 for an unsupported value
+     */
+    int (*balance)(void *, int);
+    /* optional: store in *out the smallest key not less than the given one,
+     * returns -1 when there is none
+     */
+    int (*lower_bound)(void *, int, int *);
+    size_t (*rank)(void *, int); /* optional: number of keys below a key */
+    /* optional: store in *out the key of the given rank, returns -1 when the
+     * rank is out of range
+     */
+    int (*select)(void *, size_t, int *);
+    /* optional: remove the smallest (largest) key and store it in *out,
+     * returns -1 when the set is empty
+     */
+    int (*pop_min)(void *, int *);
+    int (*pop_max)(void *, int *);
+    /* optional: read-only snapshot of the set, queried through frozen_ops */
+    void *(*freeze)(void *);
+    bool concurrent; /* insert/find/remove may be called from any thread */
+};
+
+/* Map from 64-bit keys to values of a size fixed at init, see treeint_kv.h.
+ * find returns a pointer to the value stored in the tree.
+ */
+struct treeint_kv_ops {
+    void *(*init)(size_t);
+    int (*destroy)(void *);
+    int (*insert)(void *, int64_t, const void *);
+    void *(*find)(void *, int64_t);
+    int (*remove)(void *, int64_t);
+};
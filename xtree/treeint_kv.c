@@ -0,0 +1,181 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "pool.h"
+#include "rbtree.h"
+#include "treeint_kv.h"
+#include "xtree.h"
+
+/* Both maps allocate their nodes from a pool sized for the value, which
+ * follows the key in the node: value[] is 8-byte aligned.
+ */
+struct xt_kv_node {
+    struct xt_node xt_n;
+    int64_t key;
+    unsigned char value[];
+};
+
+struct xt_kv {
+    struct xt_tree *tree;
+    struct node_pool pool;
+    size_t value_size;
+};
+
+#define xt_kv_entry(n) container_of(n, struct xt_kv_node, xt_n)
+
+static int xt_kv_cmp(struct xt_node *node, void *key)
+{
+    return cmp_int64(xt_kv_entry(node)->key, *(int64_t *) key);
+}
+
+static inline int xt_kv_node_cmp(const struct xt_node *a,
+                                 const struct xt_node *b)
+{
+    return cmp_int64(xt_kv_entry(a)->key, xt_kv_entry(b)->key);
+}
+
+static inline int xt_kv_key_cmp(const void *key, const struct xt_node *n)
+{
+    return cmp_int64(*(const int64_t *) key, xt_kv_entry(n)->key);
+}
+
+void *treeint_xt_kv_init(size_t value_size)
+{
+    struct xt_kv *kv = malloc(sizeof(struct xt_kv));
+    assert(kv);
+
+    /* nodes are created and freed here, through the inlined xt_search*() */
+    kv->tree = xt_create(xt_kv_cmp, NULL, NULL);
+    assert(kv->tree);
+    pool_init(&kv->pool, sizeof(struct xt_kv_node) + value_size,
+              TREEINT_POOL_CHUNK);
+    kv->value_size = value_size;
+    return kv;
+}
+
+int treeint_xt_kv_destroy(void *ctx)
+{
+    struct xt_kv *kv = (struct xt_kv *) ctx;
+
+    /* all nodes live in the pool: release them in bulk */
+    kv->tree->root = NULL;
+    xt_destroy(kv->tree);
+    pool_destroy(&kv->pool);
+    free(kv);
+    return 0;
+}
+
+int treeint_xt_kv_insert(void *ctx, int64_t key, const void *value)
+{
+    struct xt_kv *kv = (struct xt_kv *) ctx;
+    struct xt_kv_node *n = pool_alloc(&kv->pool);
+    assert(n);
+
+    n->key = key;
+    if (xt_search_add(&n->xt_n, kv->tree, xt_kv_node_cmp)) {
+        pool_free(&kv->pool, n);
+        return -1;
+    }
+    memcpy(n->value, value, kv->value_size);
+    return 0;
+}
+
+void *treeint_xt_kv_find(void *ctx, int64_t key)
+{
+    struct xt_kv *kv = (struct xt_kv *) ctx;
+    struct xt_node *n = xt_search(&key, kv->tree, xt_kv_key_cmp);
+
+    return n ? xt_kv_entry(n)->value : NULL;
+}
+
+int treeint_xt_kv_remove(void *ctx, int64_t key)
+{
+    struct xt_kv *kv = (struct xt_kv *) ctx;
+    struct xt_node *n = xt_search_remove(&key, kv->tree, xt_kv_key_cmp);
+
+    if (!n)
+        return -1;
+    pool_free(&kv->pool, xt_kv_entry(n));
+    return 0;
+}
+
+struct rb_kv_node {
+    struct rb_node node;
+    int64_t key;
+    unsigned char value[];
+};
+
+struct rb_kv {
+    struct rb_root_cached root;
+    struct node_pool pool;
+    size_t value_size;
+};
+
+#define rb_kv_entry(n) rb_entry(n, struct rb_kv_node, node)
+
+static int rb_kv_node_cmp(struct rb_node *a, const struct rb_node *b)
+{
+    return cmp_int64(rb_kv_entry(a)->key, rb_kv_entry(b)->key);
+}
+
+static int rb_kv_key_cmp(const void *key, const struct rb_node *n)
+{
+    return cmp_int64(*(const int64_t *) key, rb_kv_entry(n)->key);
+}
+
+void *rbtree_kv_init(size_t value_size)
+{
+    struct rb_kv *kv = malloc(sizeof(struct rb_kv));
+    assert(kv);
+
+    kv->root = RB_ROOT_CACHED;
+    pool_init(&kv->pool, sizeof(struct rb_kv_node) + value_size,
+              TREEINT_POOL_CHUNK);
+    kv->value_size = value_size;
+    return kv;
+}
+
+int rbtree_kv_destroy(void *ctx)
+{
+    struct rb_kv *kv = (struct rb_kv *) ctx;
+
+    pool_destroy(&kv->pool);
+    free(kv);
+    return 0;
+}
+
+int rbtree_kv_insert(void *ctx, int64_t key, const void *value)
+{
+    struct rb_kv *kv = (struct rb_kv *) ctx;
+    struct rb_kv_node *n = pool_alloc(&kv->pool);
+    assert(n);
+
+    n->key = key;
+    if (rb_find_add_cached(&n->node, &kv->root, rb_kv_node_cmp)) {
+        pool_free(&kv->pool, n);
+        return -1;
+    }
+    memcpy(n->value, value, kv->value_size);
+    return 0;
+}
+
+void *rbtree_kv_find(void *ctx, int64_t key)
+{
+    struct rb_kv *kv = (struct rb_kv *) ctx;
+    struct rb_node *n = rb_find(&key, &kv->root.rb_root, rb_kv_key_cmp);
+
+    return n ? rb_kv_entry(n)->value : NULL;
+}
+
+int rbtree_kv_remove(void *ctx, int64_t key)
+{
+    struct rb_kv *kv = (struct rb_kv *) ctx;
+    struct rb_node *n = rb_remove_cached(&key, &kv->root, rb_kv_key_cmp);
+
+    if (!n)
+        return -1;
+    pool_free(&kv->pool, rb_kv_entry(n));
+    return 0;
+}
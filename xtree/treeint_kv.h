@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Maps from 64-bit keys to fixed-size values, on top of XTree and the
+ * red-black tree. The value size is chosen when the map is created and the
+ * value is stored in the tree node right after the key, so find returns a
+ * pointer to it without any further lookup.
+ */
+extern void *treeint_xt_kv_init(size_t value_size);
+extern int treeint_xt_kv_destroy(void *ctx);
+extern int treeint_xt_kv_insert(void *ctx, int64_t key, const void *value);
+extern void *treeint_xt_kv_find(void *ctx, int64_t key);
+extern int treeint_xt_kv_remove(void *ctx, int64_t key);
+
+extern void *rbtree_kv_init(size_t value_size);
+extern int rbtree_kv_destroy(void *ctx);
+extern int rbtree_kv_insert(void *ctx, int64_t key, const void *value);
+extern void *rbtree_kv_find(void *ctx, int64_t key);
+extern int rbtree_kv_remove(void *ctx, int64_t key);
@@ -1,9 +1,14 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 
 #include "common.h"
+#include "eytzinger.h"
+#include "pool.h"
 #include "treeint_xt.h"
 #include "xtree.h"
+#include "xtree_int.h"
+#include "xtree_rcu.h"
 
 #define treeint_xt_entry(ptr) container_of(ptr, struct treeint_st, xt_n)
 
@@ -17,13 +22,27 @@ static int treeint_xt_cmp(struct xt_node *node, void *key)
     struct treeint_st *n = treeint_xt_entry(node);
     int value = *(int *) key;
 
-    return n->value - value;
+    return cmp_int(n->value, value);
 }
 
-static struct xt_node *treeint_xt_node_create(void *key)
+/* Comparators for the inlined xt_search*() path */
+static inline int treeint_xt_node_cmp(const struct xt_node *a,
+                                      const struct xt_node *b)
+{
+    return cmp_int(treeint_xt_entry(a)->value, treeint_xt_entry(b)->value);
+}
+
+static inline int treeint_xt_key_cmp(const void *key, const struct xt_node *n)
+{
+    return cmp_int(*(const int *) key, treeint_xt_entry(n)->value);
+}
+
+static struct xt_node *treeint_xt_node_create(struct xt_tree *tree, void *key)
 {
     int value = *(int *) key;
-    struct treeint_st *i = calloc(sizeof(struct treeint_st), 1);
+    struct node_pool *pool = tree->priv;
+    struct treeint_st *i =
+        pool ? pool_alloc(pool) : calloc(sizeof(struct treeint_st), 1);
     assert(i);
 
     i->value = value;
@@ -31,10 +50,15 @@ static struct xt_node *treeint_xt_node_create(void *key)
     return &i->xt_n;
 }
 
-static void treeint_xt_node_destroy(struct xt_node *n)
+static void treeint_xt_node_destroy(struct xt_tree *tree, struct xt_node *n)
 {
     struct treeint_st *i = treeint_xt_entry(n);
-    free(i);
+    struct node_pool *pool = tree->priv;
+
+    if (pool)
+        pool_free(pool, i);
+    else
+        free(i);
 }
 
 void *treeint_xt_init()
@@ -46,11 +70,107 @@ void *treeint_xt_init()
     return tree;
 }
 
+void *treeint_xt_init_pool()
+{
+    struct xt_tree *tree = treeint_xt_init();
+    struct node_pool *pool = malloc(sizeof(struct node_pool));
+    assert(pool);
+
+    pool_init(pool, sizeof(struct treeint_st), TREEINT_POOL_CHUNK);
+    tree->priv = pool;
+    return tree;
+}
+
+void *treeint_xt_init_deferred()
+{
+    struct xt_tree *tree = treeint_xt_init();
+    int ret = xt_set_policy(tree, XT_UPDATE_DEFERRED, TREEINT_XT_PERIOD);
+    assert(!ret);
+    (void) ret;
+    return tree;
+}
+
+void *treeint_xt_init_manual()
+{
+    struct xt_tree *tree = treeint_xt_init();
+    xt_set_policy(tree, XT_UPDATE_MANUAL, 0);
+    return tree;
+}
+
+void *treeint_xt_init_promote()
+{
+    struct xt_tree *tree = treeint_xt_init();
+    tree->find_mode = XT_FIND_PROMOTE;
+    return tree;
+}
+
+/* Depth of @a, looked up without side effects whatever the find mode */
+int treeint_xt_depth(void *ctx, int a)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node *n = xt_search(&a, tree, treeint_xt_key_cmp);
+    return n ? xt_depth(n) : -1;
+}
+
+int treeint_xt_stats(void *ctx, struct tree_shape *s)
+{
+    xt_stats((struct xt_tree *) ctx, s);
+    return 0;
+}
+
+int treeint_xt_balance(void *ctx, int balance)
+{
+    return xt_set_balance((struct xt_tree *) ctx, balance);
+}
+
+/* Fill an empty tree with the keys 0 .. n - 1 as one right spine, the worst
+ * shape for a teardown. Each node hangs below the previous one, without a
+ * search and without an update: only the manual policy keeps it that way.
+ */
+int treeint_xt_chain(void *ctx, size_t n)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node *p = NULL;
+
+    if (xt_root(tree))
+        return -1;
+
+    for (size_t i = 0; i < n; i++) {
+        int key = i;
+        struct xt_node *x = tree->create_node(tree, &key);
+
+        xt_link_node(x, p, p ? &xt_right(p) : &xt_root(tree));
+        p = x;
+    }
+    tree->leftmost = xt_root(tree);
+    tree->rightmost = p;
+    tree->count = n;
+    return 0;
+}
+
+int treeint_xt_rebalance(void *ctx)
+{
+    return xt_rebalance((struct xt_tree *) ctx);
+}
+
+int treeint_xt_height(void *ctx, double *avg_depth)
+{
+    return xt_height((struct xt_tree *) ctx, avg_depth);
+}
+
 int treeint_xt_destroy(void *ctx)
 {
     struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct node_pool *pool;
 
     assert(tree);
+    pool = tree->priv;
+    if (pool) {
+        /* all nodes live in the pool: release them in bulk */
+        tree->root = NULL;
+        pool_destroy(pool);
+        free(pool);
+    }
     xt_destroy(tree);
     return 0;
 }
@@ -72,4 +192,344 @@ int treeint_xt_remove(void *ctx, int a)
 {
     struct xt_tree *tree = (struct xt_tree *) ctx;
     return xt_remove(tree, (void *) &a);
-}
\ No newline at end of file
+}
+
+/* Count the keys in [lo, hi] through an ordered scan */
+size_t treeint_xt_range(void *ctx, int lo, int hi)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    return xt_range(tree, (void *) &lo, (void *) &hi, NULL, NULL);
+}
+
+/* Remove the smallest key and store it in *out, -1 when the tree is empty */
+int treeint_xt_pop_min(void *ctx, int *out)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node *n = xt_pop_min(tree);
+    if (!n)
+        return -1;
+
+    *out = treeint_xt_entry(n)->value;
+    treeint_xt_node_destroy(tree, n);
+    return 0;
+}
+
+int treeint_xt_pop_max(void *ctx, int *out)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node *n = xt_pop_max(tree);
+    if (!n)
+        return -1;
+
+    *out = treeint_xt_entry(n)->value;
+    treeint_xt_node_destroy(tree, n);
+    return 0;
+}
+
+int treeint_xt_lower_bound(void *ctx, int a, int *out)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node *n = xt_lower_bound(tree, (void *) &a);
+
+    if (!n)
+        return -1;
+    *out = treeint_xt_entry(n)->value;
+    return 0;
+}
+
+size_t treeint_xt_size(void *ctx)
+{
+    return ((struct xt_tree *) ctx)->count;
+}
+
+size_t treeint_xt_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    size_t count = 0;
+
+    for (struct xt_node *n = xt_min(tree); n; n = xt_next(n)) {
+        cb(treeint_xt_entry(n)->value, arg);
+        count++;
+    }
+    return count;
+}
+
+/* Read-only snapshot of the keys, see eytzinger.h. The tree is left as is. */
+void *treeint_xt_freeze(void *ctx)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct eyt_set *s;
+    size_t n = 0, i = 0;
+    int *keys;
+
+    for (struct xt_node *x = xt_min(tree); x; x = xt_next(x))
+        n++;
+    keys = malloc(sizeof(int) * (n ? n : 1));
+    assert(keys);
+    for (struct xt_node *x = xt_min(tree); x; x = xt_next(x))
+        keys[i++] = treeint_xt_entry(x)->value;
+
+    s = eyt_create(keys, n);
+    free(keys);
+    return s;
+}
+
+#define TREEINT_BATCH 256
+
+void treeint_xt_find_batch(void *ctx, const int *keys, size_t n, void **out)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    void *kp[TREEINT_BATCH];
+    struct xt_node *res[TREEINT_BATCH];
+
+    for (size_t base = 0; base < n; base += TREEINT_BATCH) {
+        size_t cnt = n - base < TREEINT_BATCH ? n - base : TREEINT_BATCH;
+
+        for (size_t i = 0; i < cnt; i++)
+            kp[i] = (void *) &keys[base + i];
+        xt_find_batch(tree, kp, cnt, res);
+        for (size_t i = 0; i < cnt; i++)
+            out[base + i] = res[i] ? treeint_xt_entry(res[i]) : NULL;
+    }
+}
+
+/* Load @n keys, sorted in ascending order without duplicates, into an empty
+ * tree through xt_build_sorted().
+ */
+int treeint_xt_build(void *ctx, const int *keys, size_t n)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node **nodes;
+    int ret;
+
+    for (size_t i = 1; i < n; i++) {
+        if (keys[i - 1] >= keys[i])
+            return -1;
+    }
+
+    nodes = malloc(sizeof(struct xt_node *) * n);
+    assert(nodes);
+    for (size_t i = 0; i < n; i++)
+        nodes[i] = treeint_xt_node_create(tree, (void *) &keys[i]);
+
+    ret = xt_build_sorted(tree, nodes, n);
+    if (ret) {
+        for (size_t i = 0; i < n; i++)
+            treeint_xt_node_destroy(tree, nodes[i]);
+    }
+    free(nodes);
+    return ret;
+}
+
+/* The same tree, driven through the header-inlined search functions */
+
+int treeint_xt_insert_inline(void *ctx, int a)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node *n = treeint_xt_node_create(tree, &a);
+
+    if (xt_search_add(n, tree, treeint_xt_node_cmp)) {
+        treeint_xt_node_destroy(tree, n);
+        return -1;
+    }
+    return 0;
+}
+
+void *treeint_xt_find_inline(void *ctx, int a)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node *n = xt_search(&a, tree, treeint_xt_key_cmp);
+    return n ? treeint_xt_entry(n) : NULL;
+}
+
+int treeint_xt_remove_inline(void *ctx, int a)
+{
+    struct xt_tree *tree = (struct xt_tree *) ctx;
+    struct xt_node *n = xt_search_remove(&a, tree, treeint_xt_key_cmp);
+    if (!n)
+        return -1;
+
+    treeint_xt_node_destroy(tree, n);
+    return 0;
+}
+
+/* Thread-safe variants. The first one serializes every operation behind a
+ * mutex, the second one lets lookups run concurrently with the writer.
+ */
+
+struct treeint_xt_locked {
+    struct xt_tree *tree;
+    pthread_mutex_t lock;
+};
+
+void *treeint_xt_locked_init()
+{
+    struct treeint_xt_locked *t = malloc(sizeof(struct treeint_xt_locked));
+    assert(t);
+
+    t->tree = treeint_xt_init();
+    pthread_mutex_init(&t->lock, NULL);
+    return t;
+}
+
+int treeint_xt_locked_destroy(void *ctx)
+{
+    struct treeint_xt_locked *t = (struct treeint_xt_locked *) ctx;
+
+    treeint_xt_destroy(t->tree);
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+    return 0;
+}
+
+int treeint_xt_locked_insert(void *ctx, int a)
+{
+    struct treeint_xt_locked *t = (struct treeint_xt_locked *) ctx;
+
+    pthread_mutex_lock(&t->lock);
+    int ret = xt_insert(t->tree, (void *) &a);
+    pthread_mutex_unlock(&t->lock);
+    return ret;
+}
+
+void *treeint_xt_locked_find(void *ctx, int a)
+{
+    struct treeint_xt_locked *t = (struct treeint_xt_locked *) ctx;
+
+    pthread_mutex_lock(&t->lock);
+    struct xt_node *n = xt_find(t->tree, (void *) &a);
+    pthread_mutex_unlock(&t->lock);
+    return n ? treeint_xt_entry(n) : NULL;
+}
+
+int treeint_xt_locked_remove(void *ctx, int a)
+{
+    struct treeint_xt_locked *t = (struct treeint_xt_locked *) ctx;
+
+    pthread_mutex_lock(&t->lock);
+    int ret = xt_remove(t->tree, (void *) &a);
+    pthread_mutex_unlock(&t->lock);
+    return ret;
+}
+
+size_t treeint_xt_locked_size(void *ctx)
+{
+    struct treeint_xt_locked *t = (struct treeint_xt_locked *) ctx;
+
+    pthread_mutex_lock(&t->lock);
+    size_t count = treeint_xt_size(t->tree);
+    pthread_mutex_unlock(&t->lock);
+    return count;
+}
+
+size_t treeint_xt_locked_iterate(void *ctx,
+                                 void (*cb)(int, void *),
+                                 void *arg)
+{
+    struct treeint_xt_locked *t = (struct treeint_xt_locked *) ctx;
+
+    pthread_mutex_lock(&t->lock);
+    size_t count = treeint_xt_iterate(t->tree, cb, arg);
+    pthread_mutex_unlock(&t->lock);
+    return count;
+}
+
+void *treeint_xt_rcu_init()
+{
+    struct xt_rcu *rcu = xt_rcu_create(treeint_xt_cmp, treeint_xt_node_create,
+                                       treeint_xt_node_destroy);
+    assert(rcu);
+    return rcu;
+}
+
+int treeint_xt_rcu_destroy(void *ctx)
+{
+    assert(ctx);
+    xt_rcu_destroy((struct xt_rcu *) ctx);
+    return 0;
+}
+
+int treeint_xt_rcu_insert(void *ctx, int a)
+{
+    return xt_rcu_insert((struct xt_rcu *) ctx, (void *) &a);
+}
+
+/* The returned node may be freed as soon as the read-side section ends, so
+ * callers may only test it against NULL.
+ */
+/* A concurrent remove may reclaim the node once xt_rcu_find() returns, so a
+ * hit is reported with the tree itself rather than with the entry.
+ */
+void *treeint_xt_rcu_find(void *ctx, int a)
+{
+    return xt_rcu_find((struct xt_rcu *) ctx, (void *) &a) ? ctx : NULL;
+}
+
+int treeint_xt_rcu_remove(void *ctx, int a)
+{
+    return xt_rcu_remove((struct xt_rcu *) ctx, (void *) &a);
+}
+
+/* Whole-tree walks take the writer mutex, which keeps every node alive and
+ * in place, without bumping the sequence counter that readers validate.
+ */
+size_t treeint_xt_rcu_size(void *ctx)
+{
+    struct xt_rcu *rcu = (struct xt_rcu *) ctx;
+
+    pthread_mutex_lock(&rcu->rcu.lock);
+    size_t count = treeint_xt_size(rcu->tree);
+    pthread_mutex_unlock(&rcu->rcu.lock);
+    return count;
+}
+
+size_t treeint_xt_rcu_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    struct xt_rcu *rcu = (struct xt_rcu *) ctx;
+
+    pthread_mutex_lock(&rcu->rcu.lock);
+    size_t count = treeint_xt_iterate(rcu->tree, cb, arg);
+    pthread_mutex_unlock(&rcu->rcu.lock);
+    return count;
+}
+
+/* Compact integer XTree, see xtree_int.h */
+
+void *treeint_xti_init()
+{
+    struct xti_tree *tree = xti_create(TREEINT_POOL_CHUNK);
+    assert(tree);
+    return tree;
+}
+
+int treeint_xti_destroy(void *ctx)
+{
+    assert(ctx);
+    xti_destroy((struct xti_tree *) ctx);
+    return 0;
+}
+
+int treeint_xti_insert(void *ctx, int a)
+{
+    return xti_insert((struct xti_tree *) ctx, a);
+}
+
+void *treeint_xti_find(void *ctx, int a)
+{
+    return xti_find((struct xti_tree *) ctx, a);
+}
+
+int treeint_xti_remove(void *ctx, int a)
+{
+    return xti_remove((struct xti_tree *) ctx, a);
+}
+
+size_t treeint_xti_size(void *ctx)
+{
+    return ((struct xti_tree *) ctx)->count;
+}
+
+size_t treeint_xti_iterate(void *ctx, void (*cb)(int, void *), void *arg)
+{
+    return xti_iterate((struct xti_tree *) ctx, cb, arg);
+}
@@ -1,7 +1,71 @@
 #pragma once
 
+#include <stddef.h>
+
+#include "stats.h"
+
+/* modifications between two update passes with treeint_xt_init_deferred() */
+#define TREEINT_XT_PERIOD 64
+
 extern void *treeint_xt_init();
+extern void *treeint_xt_init_pool();
+extern void *treeint_xt_init_deferred();
+extern void *treeint_xt_init_manual();
+extern void *treeint_xt_init_promote();
+extern int treeint_xt_depth(void *ctx, int a);
+extern int treeint_xt_rebalance(void *ctx);
+extern int treeint_xt_chain(void *ctx, size_t n);
+extern int treeint_xt_height(void *ctx, double *avg_depth);
+extern int treeint_xt_stats(void *ctx, struct tree_shape *s);
+extern int treeint_xt_balance(void *ctx, int balance);
 extern int treeint_xt_destroy(void *ctx);
 extern int treeint_xt_insert(void *ctx, int a);
 extern void *treeint_xt_find(void *ctx, int a);
-extern int treeint_xt_remove(void *ctx, int a);
\ No newline at end of file
+extern int treeint_xt_remove(void *ctx, int a);
+extern size_t treeint_xt_range(void *ctx, int lo, int hi);
+extern void *treeint_xt_freeze(void *ctx);
+extern int treeint_xt_pop_min(void *ctx, int *out);
+extern int treeint_xt_pop_max(void *ctx, int *out);
+extern int treeint_xt_lower_bound(void *ctx, int a, int *out);
+extern size_t treeint_xt_size(void *ctx);
+extern size_t treeint_xt_iterate(void *ctx,
+                                 void (*cb)(int, void *),
+                                 void *arg);
+extern void treeint_xt_find_batch(void *ctx,
+                                  const int *keys,
+                                  size_t n,
+                                  void **out);
+extern int treeint_xt_build(void *ctx, const int *keys, size_t n);
+extern int treeint_xt_insert_inline(void *ctx, int a);
+extern void *treeint_xt_find_inline(void *ctx, int a);
+extern int treeint_xt_remove_inline(void *ctx, int a);
+
+extern void *treeint_xt_locked_init();
+extern int treeint_xt_locked_destroy(void *ctx);
+extern int treeint_xt_locked_insert(void *ctx, int a);
+extern void *treeint_xt_locked_find(void *ctx, int a);
+extern int treeint_xt_locked_remove(void *ctx, int a);
+extern size_t treeint_xt_locked_size(void *ctx);
+extern size_t treeint_xt_locked_iterate(void *ctx,
+                                        void (*cb)(int, void *),
+                                        void *arg);
+
+extern void *treeint_xt_rcu_init();
+extern int treeint_xt_rcu_destroy(void *ctx);
+extern int treeint_xt_rcu_insert(void *ctx, int a);
+extern void *treeint_xt_rcu_find(void *ctx, int a);
+extern int treeint_xt_rcu_remove(void *ctx, int a);
+extern size_t treeint_xt_rcu_size(void *ctx);
+extern size_t treeint_xt_rcu_iterate(void *ctx,
+                                     void (*cb)(int, void *),
+                                     void *arg);
+
+extern void *treeint_xti_init();
+extern int treeint_xti_destroy(void *ctx);
+extern int treeint_xti_insert(void *ctx, int a);
+extern void *treeint_xti_find(void *ctx, int a);
+extern int treeint_xti_remove(void *ctx, int a);
+extern size_t treeint_xti_size(void *ctx);
+extern size_t treeint_xti_iterate(void *ctx,
+                                  void (*cb)(int, void *),
+                                  void *arg);
@@ -39,27 +39,50 @@
 
 enum xt_dir { LEFT, RIGHT, NONE };
 
-struct xt_tree *xt_create(cmp_t *cmp,
-                          struct xt_node *(*create_node)(),
-                          void (*destroy_node)(struct xt_node *n))
+struct xt_tree *xt_create(
+    cmp_t *cmp,
+    struct xt_node *(*create_node)(struct xt_tree *tree, void *key),
+    void (*destroy_node)(struct xt_tree *tree, struct xt_node *n))
 {
     struct xt_tree *tree = calloc(sizeof(struct xt_tree), 1);
     tree->root = NULL;
+    tree->leftmost = tree->rightmost = NULL;
     tree->cmp = cmp;
     tree->create_node = create_node;
     tree->destroy_node = destroy_node;
+    tree->priv = NULL;
+    tree->policy = XT_UPDATE_EAGER;
+    tree->balance = XT_BALANCE_STRICT;
+    tree->find_mode = XT_FIND_PLAIN;
     return tree;
 }
 
+/* Post-order teardown without recursion: descend to a leaf, detach it from
+ * its parent, destroy it and resume from the parent. Every edge is walked
+ * down and up once, and the stack usage does not depend on the tree shape.
+ */
 static void __xt_destroy(struct xt_tree *tree, struct xt_node *n)
 {
-    if (xt_left(n))
-        __xt_destroy(tree, xt_left(n));
+    while (n) {
+        if (xt_left(n)) {
+            n = xt_left(n);
+            continue;
+        }
 
-    if (xt_right(n))
-        __xt_destroy(tree, xt_right(n));
+        if (xt_right(n)) {
+            n = xt_right(n);
+            continue;
+        }
+
+        struct xt_node *p = xt_parent(n);
+        if (p && xt_left(p) == n)
+            xt_left(p) = NULL;
+        else if (p)
+            xt_right(p) = NULL;
 
-    tree->destroy_node(n);
+        tree->destroy_node(tree, n);
+        n = p;
+    }
 }
 
 void xt_destroy(struct xt_tree *tree)
@@ -67,41 +90,74 @@ void xt_destroy(struct xt_tree *tree)
     if (xt_root(tree))
         __xt_destroy(tree, xt_root(tree));
 
+    free(tree->pending);
     free(tree);
 }
 
 struct xt_node *xt_first(struct xt_node *n)
 {
-    if (!xt_left(n))
-        return n;
+    while (xt_left(n))
+        n = xt_left(n);
 
-    return xt_first(xt_left(n));
+    return n;
 }
 
 struct xt_node *xt_last(struct xt_node *n)
 {
-    if (!xt_right(n))
-        return n;
+    while (xt_right(n))
+        n = xt_right(n);
+
+    return n;
+}
+
+/* In-order successor and predecessor, found through the parent links alone */
+struct xt_node *xt_next(struct xt_node *n)
+{
+    if (xt_right(n))
+        return xt_first(xt_right(n));
+
+    struct xt_node *p = xt_parent(n);
+    while (p && xt_right(p) == n) {
+        n = p;
+        p = xt_parent(p);
+    }
+    return p;
+}
+
+struct xt_node *xt_prev(struct xt_node *n)
+{
+    if (xt_left(n))
+        return xt_last(xt_left(n));
 
-    return xt_last(xt_right(n));
+    struct xt_node *p = xt_parent(n);
+    while (p && xt_left(p) == n) {
+        n = p;
+        p = xt_parent(p);
+    }
+    return p;
 }
 
+/* The readers of xtree_rcu.c follow child and root links without the lock,
+ * so the insert, remove and update paths store those with WRITE_ONCE().
+ * Parent links and hints are only used by writers.
+ */
 static inline void xt_rotate_left(struct xt_node *n)
 {
     struct xt_node *l = xt_left(n), *p = xt_parent(n);
 
     xt_parent(l) = xt_parent(n);
-    xt_left(n) = xt_right(l);
+    WRITE_ONCE(xt_left(n), xt_right(l));
     xt_parent(n) = l;
-    xt_right(l) = n;
+    WRITE_ONCE(xt_right(l), n);
 
     if (p && xt_left(p) == n)
-        xt_left(p) = l;
+        WRITE_ONCE(xt_left(p), l);
     else if (p)
-        xt_right(p) = l;
+        WRITE_ONCE(xt_right(p), l);
 
     if (xt_left(n))
         xt_lparent(n) = n;
+    tree_stat_inc(rotations);
 }
 
 static inline void xt_rotate_right(struct xt_node *n)
@@ -109,17 +165,18 @@ static inline void xt_rotate_right(struct xt_node *n)
     struct xt_node *r = xt_right(n), *p = xt_parent(n);
 
     xt_parent(r) = xt_parent(n);
-    xt_right(n) = xt_left(r);
+    WRITE_ONCE(xt_right(n), xt_left(r));
     xt_parent(n) = r;
-    xt_left(r) = n;
+    WRITE_ONCE(xt_left(r), n);
 
     if (p && xt_left(p) == n)
-        xt_left(p) = r;
+        WRITE_ONCE(xt_left(p), r);
     else if (p)
-        xt_right(p) = r;
+        WRITE_ONCE(xt_right(p), r);
 
     if (xt_right(n))
         xt_rparent(n) = n;
+    tree_stat_inc(rotations);
 }
 
 static inline int xt_balance(struct xt_node *n)
@@ -148,36 +205,124 @@ static inline int xt_max_hint(struct xt_node *n)
     return l > r ? l : r;
 }
 
-static inline void xt_update(struct xt_node **root, struct xt_node *n)
+/* The update walks up from @n towards the root, one ancestor per iteration,
+ * until a node keeps a non-zero hint unchanged. Nodes leaning by more than
+ * @balance are rotated on the way.
+ */
+static inline void xt_update(struct xt_node **root,
+                             struct xt_node *n,
+                             int balance)
+{
+    unsigned int steps = 0;
+
+    tree_stat_inc(rebalances);
+    while (n) {
+        int b = xt_balance(n);
+        tree_stat_step(steps);
+        int prev_hint = n->hint;
+        struct xt_node *p = xt_parent(n);
+
+        if (b < -balance) {
+            /* leaning to the right */
+            if (xt_balance(xt_right(n)) > 0)
+                xt_rotate_left(xt_right(n));
+            if (n == *root)
+                WRITE_ONCE(*root, xt_right(n));
+            xt_rotate_right(n);
+        }
+
+        else if (b > balance) {
+            /* leaning to the left */
+            if (xt_balance(xt_left(n)) < 0)
+                xt_rotate_right(xt_left(n));
+            if (n == *root)
+                WRITE_ONCE(*root, xt_left(n));
+            xt_rotate_left(n);
+        }
+
+        n->hint = xt_max_hint(n);
+        if (n->hint != 0 && n->hint == prev_hint)
+            break;
+
+        n = p;
+    }
+}
+
+static void xt_flush(struct xt_tree *tree)
+{
+    for (unsigned int i = 0; i < tree->npending; i++)
+        xt_update(&xt_root(tree), tree->pending[i], tree->balance);
+    tree->npending = 0;
+}
+
+/* Run or postpone the update phase starting at @n, depending on the update
+ * policy of @tree.
+ */
+static inline void xt_schedule(struct xt_tree *tree, struct xt_node *n)
 {
     if (!n)
         return;
 
-    int b = xt_balance(n);
-    int prev_hint = n->hint;
-    struct xt_node *p = xt_parent(n);
+    switch (tree->policy) {
+    case XT_UPDATE_EAGER:
+        xt_update(&xt_root(tree), n, tree->balance);
+        break;
+    case XT_UPDATE_DEFERRED:
+        tree->pending[tree->npending++] = n;
+        if (tree->npending == tree->period)
+            xt_flush(tree);
+        break;
+    case XT_UPDATE_MANUAL:
+        break;
+    }
+}
 
-    if (b < -1) {
-        /* leaning to the right */
-        if (xt_balance(xt_right(n)) > 0)
-            xt_rotate_left(xt_right(n));
-        if (n == *root)
-            *root = xt_right(n);
-        xt_rotate_right(n);
+/* A node about to leave the tree must not stay queued for an update */
+static inline void xt_unschedule(struct xt_tree *tree, struct xt_node *n)
+{
+    for (unsigned int i = 0; i < tree->npending;) {
+        if (tree->pending[i] == n)
+            tree->pending[i] = tree->pending[--tree->npending];
+        else
+            i++;
     }
+}
 
-    else if (b > 1) {
-        /* leaning to the left */
-        if (xt_balance(xt_left(n)) < 0)
-            xt_rotate_right(xt_left(n));
-        if (n == *root)
-            *root = xt_left(n);
-        xt_rotate_left(n);
+int xt_set_policy(struct xt_tree *tree,
+                  enum xt_update_policy policy,
+                  unsigned int period)
+{
+    struct xt_node **pending = NULL;
+
+    if (policy == XT_UPDATE_DEFERRED) {
+        if (!period)
+            return -1;
+        pending = malloc(sizeof(struct xt_node *) * period);
+        if (!pending)
+            return -1;
     }
 
-    n->hint = xt_max_hint(n);
-    if (n->hint == 0 || n->hint != prev_hint)
-        xt_update(root, p);
+    /* catch up on whatever the previous policy left behind */
+    xt_flush(tree);
+    free(tree->pending);
+
+    tree->policy = policy;
+    tree->period = period;
+    tree->pending = pending;
+    return 0;
+}
+
+/* Takes effect from the next update on: nodes already leaning more than a
+ * tighter @balance are only fixed when an update goes through them, or by
+ * xt_rebalance().
+ */
+int xt_set_balance(struct xt_tree *tree, int balance)
+{
+    if (balance < XT_BALANCE_STRICT || balance > XT_BALANCE_MAX)
+        return -1;
+
+    tree->balance = balance;
+    return 0;
 }
 
 static struct xt_node *__xt_find(struct xt_tree *tree,
@@ -208,8 +353,10 @@ static struct xt_node *__xt_find(struct xt_tree *tree,
 
 static struct xt_node *__xt_find2(struct xt_tree *tree, void *key)
 {
+    tree_stat_inc(lookups);
     for (struct xt_node *n = xt_root(tree); n;) {
         int cmp = tree->cmp(n, key);
+        tree_stat_inc(lookup_cmps);
         if (cmp == 0)
             return n;
 
@@ -223,23 +370,43 @@ static struct xt_node *__xt_find2(struct xt_tree *tree, void *key)
     return NULL;
 }
 
+/* Account for a newly linked node. It is the new minimum iff it became the
+ * left child of the old one (or the tree was empty), and likewise for the
+ * maximum.
+ */
+static inline void xt_cache_insert(struct xt_tree *tree, struct xt_node *n)
+{
+    struct xt_node *p = xt_parent(n);
+
+    tree->count++;
+    if (!p) {
+        tree->leftmost = tree->rightmost = n;
+        return;
+    }
+    if (p == tree->leftmost && xt_left(p) == n)
+        tree->leftmost = n;
+    else if (p == tree->rightmost && xt_right(p) == n)
+        tree->rightmost = n;
+}
+
 /* The process of insertion is straightforward and follows the standard approach
  * used in any BST. After inserting a new node into the tree using conventional
  * BST insertion techniques, an update operation is invoked on the newly
  * inserted node.
  */
-static void __xt_insert(struct xt_node **root,
+static void __xt_insert(struct xt_tree *tree,
                         struct xt_node *p,
                         struct xt_node *n,
                         enum xt_dir d)
 {
     if (d == LEFT)
-        xt_left(p) = n;
+        WRITE_ONCE(xt_left(p), n);
     else
-        xt_right(p) = n;
+        WRITE_ONCE(xt_right(p), n);
 
     xt_parent(n) = p;
-    xt_update(root, n);
+    xt_cache_insert(tree, n);
+    xt_schedule(tree, n);
 }
 
 int xt_insert(struct xt_tree *tree, void *key)
@@ -250,12 +417,14 @@ int xt_insert(struct xt_tree *tree, void *key)
     if (n != NULL)
         return -1;
 
-    n = tree->create_node(key);
+    n = tree->create_node(tree, key);
     if (xt_root(tree)) {
         assert(d != NONE);
-        __xt_insert(&xt_root(tree), p, n, d);
-    } else
-        xt_root(tree) = n;
+        __xt_insert(tree, p, n, d);
+    } else {
+        WRITE_ONCE(xt_root(tree), n);
+        xt_cache_insert(tree, n);
+    }
 
     return 0;
 }
@@ -265,7 +434,7 @@ static inline void xt_replace_right(struct xt_node *n, struct xt_node *r)
     struct xt_node *p = xt_parent(n), *rp = xt_parent(r);
 
     if (xt_left(rp) == r) {
-        xt_left(rp) = xt_right(r);
+        WRITE_ONCE(xt_left(rp), xt_right(r));
         if (xt_right(r))
             xt_rparent(r) = rp;
     }
@@ -274,17 +443,17 @@ static inline void xt_replace_right(struct xt_node *n, struct xt_node *r)
         xt_parent(rp) = r;
 
     xt_parent(r) = p;
-    xt_left(r) = xt_left(n);
+    WRITE_ONCE(xt_left(r), xt_left(n));
 
     if (xt_right(n) != r) {
-        xt_right(r) = xt_right(n);
+        WRITE_ONCE(xt_right(r), xt_right(n));
         xt_rparent(n) = r;
     }
 
     if (p && xt_left(p) == n)
-        xt_left(p) = r;
+        WRITE_ONCE(xt_left(p), r);
     else if (p)
-        xt_right(p) = r;
+        WRITE_ONCE(xt_right(p), r);
 
     if (xt_left(n))
         xt_lparent(n) = r;
@@ -295,7 +464,7 @@ static inline void xt_replace_left(struct xt_node *n, struct xt_node *l)
     struct xt_node *p = xt_parent(n), *lp = xt_parent(l);
 
     if (xt_right(lp) == l) {
-        xt_right(lp) = xt_left(l);
+        WRITE_ONCE(xt_right(lp), xt_left(l));
         if (xt_left(l))
             xt_lparent(l) = lp;
     }
@@ -304,17 +473,17 @@ static inline void xt_replace_left(struct xt_node *n, struct xt_node *l)
         xt_parent(lp) = l;
 
     xt_parent(l) = p;
-    xt_right(l) = xt_right(n);
+    WRITE_ONCE(xt_right(l), xt_right(n));
 
     if (xt_left(n) != l) {
-        xt_left(l) = xt_left(n);
+        WRITE_ONCE(xt_left(l), xt_left(n));
         xt_lparent(n) = l;
     }
 
     if (p && xt_left(p) == n)
-        xt_left(p) = l;
+        WRITE_ONCE(xt_left(p), l);
     else if (p)
-        xt_right(p) = l;
+        WRITE_ONCE(xt_right(p), l);
 
     if (xt_right(n))
         xt_rparent(n) = l;
@@ -336,30 +505,42 @@ static inline void xt_replace_left(struct xt_node *n, struct xt_node *l)
  * right), it can be directly removed from the tree, and an update operation is
  * invoked on the parent node of the deleted node.
  */
-static void __xt_remove(struct xt_node **root, struct xt_node *del)
+static void __xt_remove(struct xt_tree *tree, struct xt_node *del)
 {
+    struct xt_node **root = &xt_root(tree);
+
+    if (tree->npending)
+        xt_unschedule(tree, del);
+    tree->count--;
+
+    /* the minimum has no left child, so its successor is close by */
+    if (del == tree->leftmost)
+        tree->leftmost = xt_next(del);
+    if (del == tree->rightmost)
+        tree->rightmost = xt_prev(del);
+
     if (xt_right(del)) {
         struct xt_node *least = xt_first(xt_right(del));
         if (del == *root)
-            *root = least;
+            WRITE_ONCE(*root, least);
 
         xt_replace_right(del, least);
-        xt_update(root, xt_right(least));
+        xt_schedule(tree, xt_right(least));
         return;
     }
 
     if (xt_left(del)) {
         struct xt_node *most = xt_last(xt_left(del));
         if (del == *root)
-            *root = most;
+            WRITE_ONCE(*root, most);
 
         xt_replace_left(del, most);
-        xt_update(root, xt_left(most));
+        xt_schedule(tree, xt_left(most));
         return;
     }
 
     if (del == *root) {
-        *root = 0;
+        WRITE_ONCE(*root, NULL);
         return;
     }
 
@@ -367,26 +548,365 @@ static void __xt_remove(struct xt_node **root, struct xt_node *del)
     struct xt_node *parent = xt_parent(del);
 
     if (xt_left(parent) == del)
-        xt_left(parent) = 0;
+        WRITE_ONCE(xt_left(parent), NULL);
     else
-        xt_right(parent) = 0;
+        WRITE_ONCE(xt_right(parent), NULL);
+
+    xt_schedule(tree, parent);
+}
+
+static struct xt_node *__xt_build(struct xt_node **nodes,
+                                  size_t lo,
+                                  size_t hi,
+                                  struct xt_node *parent)
+{
+    if (lo == hi)
+        return NULL;
 
-    xt_update(root, parent);
+    size_t mid = lo + (hi - lo) / 2;
+    struct xt_node *n = nodes[mid];
+
+    xt_parent(n) = parent;
+    xt_left(n) = __xt_build(nodes, lo, mid, n);
+    xt_right(n) = __xt_build(nodes, mid + 1, hi, n);
+    n->hint = xt_max_hint(n);
+    return n;
+}
+
+/* Bulk loading builds a perfectly balanced tree out of @nodes, which must be
+ * sorted in ascending key order and free of duplicates, by recursively
+ * picking the median as subtree root. Every node is visited once and no
+ * rotation is needed, and since subtree sizes differ by at most one the hints
+ * come out exact. The tree must be empty.
+ */
+int xt_build_sorted(struct xt_tree *tree, struct xt_node **nodes, size_t n)
+{
+    if (xt_root(tree))
+        return -1;
+
+    xt_root(tree) = __xt_build(nodes, 0, n, NULL);
+    tree->leftmost = n ? nodes[0] : NULL;
+    tree->rightmost = n ? nodes[n - 1] : NULL;
+    tree->count = n;
+    return 0;
 }
 
+/* Depth histogram and height of @tree, through an in-order walk along the
+ * parent links that tracks the depth of the current node.
+ */
+void xt_stats(struct xt_tree *tree, struct tree_shape *s)
+{
+    struct xt_node *n = xt_root(tree);
+    unsigned int depth = 1;
+
+    tree_shape_init(s);
+    for (; n && xt_left(n); depth++)
+        n = xt_left(n);
+
+    while (n) {
+        tree_shape_add(s, depth);
+        if (xt_right(n)) {
+            n = xt_right(n);
+            for (depth++; xt_left(n); depth++)
+                n = xt_left(n);
+            continue;
+        }
+
+        struct xt_node *p = xt_parent(n);
+        for (depth--; p && xt_right(p) == n; depth--) {
+            n = p;
+            p = xt_parent(p);
+        }
+        n = p;
+    }
+    tree_shape_done(s);
+}
+
+/* Restore the balance of the whole tree, whatever the update policy skipped,
+ * by rebuilding it from its in-order sequence. This is a linear pass with
+ * one temporary array of node pointers, and it leaves every hint exact.
+ */
+int xt_rebalance(struct xt_tree *tree)
+{
+    struct xt_node **nodes;
+    size_t n = 0, i = 0;
+
+    tree->npending = 0;
+    if (!xt_root(tree))
+        return 0;
+
+    for (struct xt_node *x = xt_first(xt_root(tree)); x; x = xt_next(x))
+        n++;
+
+    nodes = malloc(sizeof(struct xt_node *) * n);
+    if (!nodes)
+        return -1;
+    for (struct xt_node *x = xt_first(xt_root(tree)); x; x = xt_next(x))
+        nodes[i++] = x;
+
+    xt_root(tree) = __xt_build(nodes, 0, n, NULL);
+    free(nodes);
+    return 0;
+}
+
+/* Returns the number of levels of the tree, and the average node depth,
+ * counting the root as depth 1, through @avg_depth when non-NULL. The walk
+ * follows parent links so it uses constant space.
+ */
+int xt_height(struct xt_tree *tree, double *avg_depth)
+{
+    struct xt_node *n = xt_root(tree), *prev = NULL;
+    int depth = 1, height = 0;
+    size_t count = 0, sum = 0;
+
+    while (n) {
+        struct xt_node *next;
+
+        if (prev == xt_parent(n)) {
+            /* first visit */
+            count++;
+            sum += depth;
+            if (depth > height)
+                height = depth;
+
+            if (xt_left(n))
+                next = xt_left(n);
+            else if (xt_right(n))
+                next = xt_right(n);
+            else
+                next = xt_parent(n);
+        } else if (prev == xt_left(n) && xt_right(n)) {
+            next = xt_right(n);
+        } else {
+            next = xt_parent(n);
+        }
+
+        depth += next == xt_parent(n) ? -1 : 1;
+        prev = n;
+        n = next;
+    }
+
+    if (avg_depth)
+        *avg_depth = count ? (double) sum / count : 0;
+    return height;
+}
+
+void xt_insert_update(struct xt_node *node, struct xt_tree *tree)
+{
+    xt_cache_insert(tree, node);
+    xt_schedule(tree, node);
+}
+
+void xt_erase(struct xt_node *node, struct xt_tree *tree)
+{
+    __xt_remove(tree, node);
+}
+
+/* Returns the first node whose key is not less than @key, or NULL */
+struct xt_node *xt_lower_bound(struct xt_tree *tree, void *key)
+{
+    struct xt_node *lb = NULL;
+
+    for (struct xt_node *n = xt_root(tree); n;) {
+        int cmp = tree->cmp(n, key);
+        if (cmp == 0)
+            return n;
+
+        if (cmp > 0) {
+            lb = n;
+            n = xt_left(n);
+        } else {
+            n = xt_right(n);
+        }
+    }
+
+    return lb;
+}
+
+/* Visit the nodes with keys in [@lo, @hi] in ascending order. Walking from
+ * the lower bound with xt_next() needs neither recursion nor allocation. The
+ * scan stops early when @cb returns non-zero. Returns the number of nodes
+ * passed to @cb.
+ */
+size_t xt_range(struct xt_tree *tree,
+                void *lo,
+                void *hi,
+                int (*cb)(struct xt_node *n, void *arg),
+                void *arg)
+{
+    size_t count = 0;
+
+    for (struct xt_node *n = xt_lower_bound(tree, lo);
+         n && tree->cmp(n, hi) <= 0; n = xt_next(n)) {
+        count++;
+        if (cb && cb(n, arg))
+            break;
+    }
+
+    return count;
+}
+
+/* Move @n one level up by rotating it over its parent. The hints of the two
+ * nodes are recomputed, and the change is propagated to the ancestors, but
+ * no update phase runs, as it would undo the promotion. Instead, a promotion
+ * that would leave @n leaning by more than XT_PROMOTE_SLACK levels towards its
+ * former parent is not performed, so that cold subtrees are not pushed down
+ * without bound.
+ */
+#define XT_PROMOTE_SLACK 3
+
+static inline int xt_levels(struct xt_node *n)
+{
+    return n ? n->hint + 1 : 0;
+}
+
+static void xt_promote(struct xt_tree *tree, struct xt_node *n)
+{
+    struct xt_node *p = xt_parent(n), *inner, *outer, *sibling;
+
+    if (!p)
+        return;
+
+    if (xt_left(p) == n) {
+        inner = xt_right(n);
+        outer = xt_left(n);
+        sibling = xt_right(p);
+    } else {
+        inner = xt_left(n);
+        outer = xt_right(n);
+        sibling = xt_left(p);
+    }
+
+    int lean = xt_levels(inner) > xt_levels(sibling) ? xt_levels(inner)
+                                                      : xt_levels(sibling);
+    lean = lean + 1 - xt_levels(outer);
+    if (lean > XT_PROMOTE_SLACK || lean < -XT_PROMOTE_SLACK)
+        return;
+
+    if (p == xt_root(tree))
+        WRITE_ONCE(xt_root(tree), n);
+
+    if (xt_left(p) == n)
+        xt_rotate_left(p);
+    else
+        xt_rotate_right(p);
+
+    p->hint = xt_max_hint(p);
+    n->hint = xt_max_hint(n);
+
+    for (p = xt_parent(n); p; p = xt_parent(p)) {
+        int hint = xt_max_hint(p);
+        if (hint == p->hint)
+            break;
+        p->hint = hint;
+    }
+}
+
+/* With XT_FIND_PROMOTE, every successful lookup moves the node it found one
+ * level closer to the root. Frequently accessed keys thus drift towards the
+ * top of the tree, which shortens their search path under skewed workloads,
+ * at the price of turning lookups into writes.
+ */
 struct xt_node *xt_find(struct xt_tree *tree, void *key)
 {
-    return __xt_find2(tree, key);
+    struct xt_node *n = __xt_find2(tree, key);
+
+    if (n && tree->find_mode == XT_FIND_PROMOTE)
+        xt_promote(tree, n);
+    return n;
+}
+
+/* Number of nodes on the path from the root to @n, both included */
+int xt_depth(struct xt_node *n)
+{
+    int depth = 0;
+
+    for (; n; n = xt_parent(n))
+        depth++;
+    return depth;
 }
 
+/* Batched lookup. A single search stalls on a cache miss at every level of a
+ * large tree. Here up to XT_FIND_BATCH searches advance in lockstep, one
+ * level per round, and the next node of each search is prefetched while the
+ * others are being compared, so that the misses overlap instead of adding up.
+ */
+#define XT_FIND_BATCH 16
+
+void xt_find_batch(struct xt_tree *tree,
+                   void *const *keys,
+                   size_t n,
+                   struct xt_node **out)
+{
+    struct xt_node *cur[XT_FIND_BATCH];
+
+    for (size_t base = 0; base < n; base += XT_FIND_BATCH) {
+        size_t cnt = n - base < XT_FIND_BATCH ? n - base : XT_FIND_BATCH;
+        size_t active = 0;
+
+        for (size_t i = 0; i < cnt; i++) {
+            cur[i] = xt_root(tree);
+            out[base + i] = NULL;
+            if (cur[i])
+                active++;
+        }
+
+        while (active) {
+            for (size_t i = 0; i < cnt; i++) {
+                struct xt_node *node = cur[i];
+                if (!node)
+                    continue;
+
+                int cmp = tree->cmp(node, keys[base + i]);
+                if (cmp == 0) {
+                    out[base + i] = node;
+                    node = NULL;
+                } else {
+                    node = cmp > 0 ? xt_left(node) : xt_right(node);
+                }
+
+                cur[i] = node;
+                if (node)
+                    __builtin_prefetch(node);
+                else
+                    active--;
+            }
+        }
+    }
+}
+
+/* Unlink the smallest node of @tree and return it, or NULL when the tree is
+ * empty. As with xt_search_remove(), the caller frees the node.
+ */
+struct xt_node *xt_pop_min(struct xt_tree *tree)
+{
+    struct xt_node *n = xt_min(tree);
+
+    if (n)
+        __xt_remove(tree, n);
+    return n;
+}
+
+struct xt_node *xt_pop_max(struct xt_tree *tree)
+{
+    struct xt_node *n = xt_max(tree);
+
+    if (n)
+        __xt_remove(tree, n);
+    return n;
+}
+
+/* Look the victim up without promoting it: rotating a node that is about to
+ * be unlinked would only be undone by the removal.
+ */
 int xt_remove(struct xt_tree *tree, void *key)
 {
-    struct xt_node *n = xt_find(tree, key);
+    struct xt_node *n = __xt_find2(tree, key);
     if (!n)
         return -1;
 
-    __xt_remove(&xt_root(tree), n);
-    tree->destroy_node(n);
+    __xt_remove(tree, n);
+    tree->destroy_node(tree, n);
 
     return 0;
 }
\ No newline at end of file
@@ -1,11 +1,19 @@
 #pragma once
 
+#include "common.h"
+#include "stats.h"
+
 #define xt_root(r) (r->root)
 #define xt_left(n) (n->left)
 #define xt_right(n) (n->right)
 #define xt_rparent(n) (xt_right(n)->parent)
 #define xt_lparent(n) (xt_left(n)->parent)
 #define xt_parent(n) (n->parent)
+/* Smallest and largest nodes, kept up to date on every insertion and
+ * removal so that they do not cost a spine walk.
+ */
+#define xt_min(r) (r->leftmost)
+#define xt_max(r) (r->rightmost)
 
 /* XTree uses hints to decide whether to perform a balancing operation or not.
  * Hints are similar to AVL-trees' height property, but they are not
@@ -18,18 +26,191 @@ struct xt_node {
     struct xt_node *left, *right;
 };
 
+/* When to run the update phase after an insertion or removal:
+ * - XT_UPDATE_EAGER: right away, which is the default;
+ * - XT_UPDATE_DEFERRED: queue the update and run the queued ones every
+ *   @period modifications;
+ * - XT_UPDATE_MANUAL: never, until the user calls xt_rebalance().
+ */
+enum xt_update_policy {
+    XT_UPDATE_EAGER,
+    XT_UPDATE_DEFERRED,
+    XT_UPDATE_MANUAL,
+};
+
+/* What xt_find() does to the node it found:
+ * - XT_FIND_PLAIN: nothing, lookups are read-only;
+ * - XT_FIND_PROMOTE: rotate it one level up, refreshing the hints on the way.
+ */
+enum xt_find_mode {
+    XT_FIND_PLAIN,
+    XT_FIND_PROMOTE,
+};
+
+/* Hint difference between the two subtrees of a node that the update
+ * tolerates before rotating: 1 keeps the tree AVL-strict, larger values let
+ * it grow deeper in exchange for fewer rotations on modifications.
+ */
+#define XT_BALANCE_STRICT 1
+#define XT_BALANCE_MAX 8
+
 typedef int cmp_t(struct xt_node *node, void *key);
 struct xt_tree {
     struct xt_node *root;
+    struct xt_node *leftmost, *rightmost;
+    size_t count; /* linked nodes */
     cmp_t *cmp;
-    struct xt_node *(*create_node)(void *key);
-    void (*destroy_node)(struct xt_node *n);
+    struct xt_node *(*create_node)(struct xt_tree *tree, void *key);
+    void (*destroy_node)(struct xt_tree *tree, struct xt_node *n);
+    void *priv; /* owned by the user, e.g. a node allocator */
+
+    enum xt_update_policy policy;
+    unsigned int period;
+    unsigned int npending;
+    struct xt_node **pending; /* update starting points not yet run */
+    int balance;              /* tolerated imbalance, see XT_BALANCE_MAX */
+
+    enum xt_find_mode find_mode;
 };
 
-struct xt_tree *xt_create(cmp_t *cmp,
-                          struct xt_node *(*create_node)(void *key),
-                          void (*destroy_node)(struct xt_node *n));
+struct xt_tree *xt_create(
+    cmp_t *cmp,
+    struct xt_node *(*create_node)(struct xt_tree *tree, void *key),
+    void (*destroy_node)(struct xt_tree *tree, struct xt_node *n));
 void xt_destroy(struct xt_tree *tree);
 int xt_insert(struct xt_tree *tree, void *key);
 int xt_remove(struct xt_tree *tree, void *key);
-struct xt_node *xt_find(struct xt_tree *tree, void *key);
\ No newline at end of file
+struct xt_node *xt_find(struct xt_tree *tree, void *key);
+struct xt_node *xt_pop_min(struct xt_tree *tree);
+struct xt_node *xt_pop_max(struct xt_tree *tree);
+int xt_depth(struct xt_node *n);
+struct xt_node *xt_first(struct xt_node *n);
+struct xt_node *xt_last(struct xt_node *n);
+struct xt_node *xt_next(struct xt_node *n);
+struct xt_node *xt_prev(struct xt_node *n);
+struct xt_node *xt_lower_bound(struct xt_tree *tree, void *key);
+size_t xt_range(struct xt_tree *tree,
+                void *lo,
+                void *hi,
+                int (*cb)(struct xt_node *n, void *arg),
+                void *arg);
+void xt_find_batch(struct xt_tree *tree,
+                   void *const *keys,
+                   size_t n,
+                   struct xt_node **out);
+int xt_build_sorted(struct xt_tree *tree, struct xt_node **nodes, size_t n);
+int xt_set_policy(struct xt_tree *tree,
+                  enum xt_update_policy policy,
+                  unsigned int period);
+int xt_set_balance(struct xt_tree *tree, int balance);
+int xt_rebalance(struct xt_tree *tree);
+int xt_height(struct xt_tree *tree, double *avg_depth);
+void xt_stats(struct xt_tree *tree, struct tree_shape *s);
+
+extern void xt_insert_update(struct xt_node *node, struct xt_tree *tree);
+extern void xt_erase(struct xt_node *node, struct xt_tree *tree);
+
+/* The functions below mirror rb_find(), rb_find_add() and rb_remove() in
+ * rbtree.h. They take the comparator as an argument instead of going through
+ * tree->cmp, so that the compiler can inline it into the search loop. The
+ * caller owns the node memory: tree->create_node and tree->destroy_node are
+ * not used.
+ */
+
+static inline void xt_link_node(struct xt_node *node,
+                                struct xt_node *parent,
+                                struct xt_node **link)
+{
+    node->hint = 0;
+    node->parent = parent;
+    node->left = node->right = NULL;
+
+    *link = node;
+}
+
+/**
+ * xt_search_add() - find equivalent @node in @tree, or add @node
+ * @node: node to look-for / insert
+ * @tree: tree to search / modify
+ * @cmp: operator defining the node order
+ *
+ * Returns the xt_node matching @node, or NULL when no match is found and @node
+ * is inserted.
+ */
+static __always_inline struct xt_node *xt_search_add(
+    struct xt_node *node,
+    struct xt_tree *tree,
+    int (*cmp)(const struct xt_node *, const struct xt_node *))
+{
+    struct xt_node **link = &tree->root;
+    struct xt_node *parent = NULL;
+    int c;
+
+    while (*link) {
+        parent = *link;
+        c = cmp(node, parent);
+
+        if (c < 0)
+            link = &parent->left;
+        else if (c > 0)
+            link = &parent->right;
+        else
+            return parent;
+    }
+
+    xt_link_node(node, parent, link);
+    xt_insert_update(node, tree);
+    return NULL;
+}
+
+/**
+ * xt_search() - find @key in tree @tree
+ * @key: key to match
+ * @tree: tree to search
+ * @cmp: operator defining the node order
+ *
+ * Returns the xt_node matching @key or NULL.
+ */
+static __always_inline struct xt_node *xt_search(
+    const void *key,
+    const struct xt_tree *tree,
+    int (*cmp)(const void *key, const struct xt_node *))
+{
+    struct xt_node *node = tree->root;
+
+    tree_stat_inc(lookups);
+    while (node) {
+        int c = cmp(key, node);
+
+        tree_stat_inc(lookup_cmps);
+        if (c < 0)
+            node = node->left;
+        else if (c > 0)
+            node = node->right;
+        else
+            return node;
+    }
+
+    return NULL;
+}
+
+/**
+ * xt_search_remove() - unlink the node matching @key from @tree
+ * @key: key to remove
+ * @tree: tree to modify
+ * @cmp: operator defining the node order
+ *
+ * Returns the unlinked xt_node, which the caller is responsible for freeing,
+ * or NULL when @key is not in @tree.
+ */
+static __always_inline struct xt_node *xt_search_remove(
+    const void *key,
+    struct xt_tree *tree,
+    int (*cmp)(const void *key, const struct xt_node *))
+{
+    struct xt_node *node = xt_search(key, tree, cmp);
+
+    if (node)
+        xt_erase(node, tree);
+    return node;
+}
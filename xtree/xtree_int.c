@@ -0,0 +1,373 @@
+/*
+ * Compact integer XTree.
+ *
+ * This follows the algorithms of xtree.c step by step; only the node
+ * representation differs. See xtree.c for a description of the update phase.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "xtree_int.h"
+
+#define XTI_NIL 0
+
+#define xti_node(t, i) (&(t)->nodes[i])
+#define xti_key(t, i) (xti_node(t, i)->key)
+#define xti_left(t, i) (xti_node(t, i)->left)
+#define xti_right(t, i) (xti_node(t, i)->right)
+#define xti_parent(t, i) (xti_node(t, i)->parent)
+#define xti_hint(t, i) ((t)->hints[i])
+
+struct xti_tree *xti_create(uint32_t capacity)
+{
+    struct xti_tree *tree = calloc(sizeof(struct xti_tree), 1);
+    if (!tree)
+        return NULL;
+
+    /* slot 0 is the null link */
+    if (capacity < 2)
+        capacity = 2;
+    tree->nodes = malloc(sizeof(struct xti_node) * capacity);
+    tree->hints = malloc(sizeof(int16_t) * capacity);
+    if (!tree->nodes || !tree->hints) {
+        xti_destroy(tree);
+        return NULL;
+    }
+
+    tree->root = XTI_NIL;
+    tree->free_list = XTI_NIL;
+    tree->used = 1;
+    tree->capacity = capacity;
+    return tree;
+}
+
+void xti_destroy(struct xti_tree *tree)
+{
+    free(tree->nodes);
+    free(tree->hints);
+    free(tree);
+}
+
+static uint32_t xti_alloc(struct xti_tree *tree, int key)
+{
+    uint32_t n;
+
+    if (tree->free_list != XTI_NIL) {
+        n = tree->free_list;
+        tree->free_list = xti_left(tree, n);
+    } else {
+        if (tree->used == tree->capacity) {
+            uint32_t cap = tree->capacity * 2;
+            struct xti_node *nodes =
+                realloc(tree->nodes, sizeof(struct xti_node) * cap);
+            if (!nodes)
+                return XTI_NIL;
+            tree->nodes = nodes;
+
+            int16_t *hints = realloc(tree->hints, sizeof(int16_t) * cap);
+            if (!hints)
+                return XTI_NIL;
+            tree->hints = hints;
+            tree->capacity = cap;
+        }
+        n = tree->used++;
+    }
+
+    xti_key(tree, n) = key;
+    xti_parent(tree, n) = XTI_NIL;
+    xti_left(tree, n) = xti_right(tree, n) = XTI_NIL;
+    xti_hint(tree, n) = 0;
+    tree->count++;
+    return n;
+}
+
+static inline void xti_release(struct xti_tree *tree, uint32_t n)
+{
+    xti_left(tree, n) = tree->free_list;
+    tree->free_list = n;
+    tree->count--;
+}
+
+static inline uint32_t xti_first(struct xti_tree *tree, uint32_t n)
+{
+    while (xti_left(tree, n))
+        n = xti_left(tree, n);
+    return n;
+}
+
+static inline uint32_t xti_last(struct xti_tree *tree, uint32_t n)
+{
+    while (xti_right(tree, n))
+        n = xti_right(tree, n);
+    return n;
+}
+
+static inline void xti_set_child(struct xti_tree *tree,
+                                 uint32_t p,
+                                 uint32_t old,
+                                 uint32_t new)
+{
+    if (p && xti_left(tree, p) == old)
+        xti_left(tree, p) = new;
+    else if (p)
+        xti_right(tree, p) = new;
+}
+
+static inline void xti_rotate_left(struct xti_tree *tree, uint32_t n)
+{
+    uint32_t l = xti_left(tree, n), p = xti_parent(tree, n);
+
+    xti_parent(tree, l) = p;
+    xti_left(tree, n) = xti_right(tree, l);
+    xti_parent(tree, n) = l;
+    xti_right(tree, l) = n;
+
+    xti_set_child(tree, p, n, l);
+
+    if (xti_left(tree, n))
+        xti_parent(tree, xti_left(tree, n)) = n;
+}
+
+static inline void xti_rotate_right(struct xti_tree *tree, uint32_t n)
+{
+    uint32_t r = xti_right(tree, n), p = xti_parent(tree, n);
+
+    xti_parent(tree, r) = p;
+    xti_right(tree, n) = xti_left(tree, r);
+    xti_parent(tree, n) = r;
+    xti_left(tree, r) = n;
+
+    xti_set_child(tree, p, n, r);
+
+    if (xti_right(tree, n))
+        xti_parent(tree, xti_right(tree, n)) = n;
+}
+
+static inline int xti_balance(struct xti_tree *tree, uint32_t n)
+{
+    int l = 0, r = 0;
+
+    if (xti_left(tree, n))
+        l = xti_hint(tree, xti_left(tree, n)) + 1;
+
+    if (xti_right(tree, n))
+        r = xti_hint(tree, xti_right(tree, n)) + 1;
+
+    return l - r;
+}
+
+static inline int xti_max_hint(struct xti_tree *tree, uint32_t n)
+{
+    int l = 0, r = 0;
+
+    if (xti_left(tree, n))
+        l = xti_hint(tree, xti_left(tree, n)) + 1;
+
+    if (xti_right(tree, n))
+        r = xti_hint(tree, xti_right(tree, n)) + 1;
+
+    return l > r ? l : r;
+}
+
+static void xti_update(struct xti_tree *tree, uint32_t n)
+{
+    while (n) {
+        int b = xti_balance(tree, n);
+        int prev_hint = xti_hint(tree, n);
+        uint32_t p = xti_parent(tree, n);
+
+        if (b < -1) {
+            /* leaning to the right */
+            if (xti_balance(tree, xti_right(tree, n)) > 0)
+                xti_rotate_left(tree, xti_right(tree, n));
+            if (n == tree->root)
+                tree->root = xti_right(tree, n);
+            xti_rotate_right(tree, n);
+        } else if (b > 1) {
+            /* leaning to the left */
+            if (xti_balance(tree, xti_left(tree, n)) < 0)
+                xti_rotate_right(tree, xti_left(tree, n));
+            if (n == tree->root)
+                tree->root = xti_left(tree, n);
+            xti_rotate_left(tree, n);
+        }
+
+        xti_hint(tree, n) = xti_max_hint(tree, n);
+        if (xti_hint(tree, n) != 0 && xti_hint(tree, n) == prev_hint)
+            break;
+        n = p;
+    }
+}
+
+static uint32_t __xti_find(struct xti_tree *tree, int key)
+{
+    uint32_t n = tree->root;
+
+    while (n) {
+        int k = xti_key(tree, n);
+        if (key == k)
+            break;
+        n = key < k ? xti_left(tree, n) : xti_right(tree, n);
+    }
+
+    return n;
+}
+
+int *xti_find(struct xti_tree *tree, int key)
+{
+    uint32_t n = __xti_find(tree, key);
+    return n ? &xti_key(tree, n) : NULL;
+}
+
+int xti_insert(struct xti_tree *tree, int key)
+{
+    uint32_t p = XTI_NIL, n = tree->root;
+    int left = 0;
+
+    while (n) {
+        int k = xti_key(tree, n);
+        if (key == k)
+            return -1;
+        p = n;
+        left = key < k;
+        n = left ? xti_left(tree, n) : xti_right(tree, n);
+    }
+
+    n = xti_alloc(tree, key);
+    if (!n)
+        return -1;
+
+    if (!p) {
+        tree->root = n;
+        return 0;
+    }
+
+    if (left)
+        xti_left(tree, p) = n;
+    else
+        xti_right(tree, p) = n;
+    xti_parent(tree, n) = p;
+    xti_update(tree, n);
+    return 0;
+}
+
+static inline void xti_replace_right(struct xti_tree *tree,
+                                     uint32_t n,
+                                     uint32_t r)
+{
+    uint32_t p = xti_parent(tree, n), rp = xti_parent(tree, r);
+
+    if (xti_left(tree, rp) == r) {
+        xti_left(tree, rp) = xti_right(tree, r);
+        if (xti_right(tree, r))
+            xti_parent(tree, xti_right(tree, r)) = rp;
+    }
+
+    if (xti_parent(tree, rp) == n)
+        xti_parent(tree, rp) = r;
+
+    xti_parent(tree, r) = p;
+    xti_left(tree, r) = xti_left(tree, n);
+
+    if (xti_right(tree, n) != r) {
+        xti_right(tree, r) = xti_right(tree, n);
+        xti_parent(tree, xti_right(tree, n)) = r;
+    }
+
+    xti_set_child(tree, p, n, r);
+
+    if (xti_left(tree, n))
+        xti_parent(tree, xti_left(tree, n)) = r;
+}
+
+static inline void xti_replace_left(struct xti_tree *tree,
+                                    uint32_t n,
+                                    uint32_t l)
+{
+    uint32_t p = xti_parent(tree, n), lp = xti_parent(tree, l);
+
+    if (xti_right(tree, lp) == l) {
+        xti_right(tree, lp) = xti_left(tree, l);
+        if (xti_left(tree, l))
+            xti_parent(tree, xti_left(tree, l)) = lp;
+    }
+
+    if (xti_parent(tree, lp) == n)
+        xti_parent(tree, lp) = l;
+
+    xti_parent(tree, l) = p;
+    xti_right(tree, l) = xti_right(tree, n);
+
+    if (xti_left(tree, n) != l) {
+        xti_left(tree, l) = xti_left(tree, n);
+        xti_parent(tree, xti_left(tree, n)) = l;
+    }
+
+    xti_set_child(tree, p, n, l);
+
+    if (xti_right(tree, n))
+        xti_parent(tree, xti_right(tree, n)) = l;
+}
+
+int xti_remove(struct xti_tree *tree, int key)
+{
+    uint32_t del = __xti_find(tree, key);
+    if (!del)
+        return -1;
+
+    if (xti_right(tree, del)) {
+        uint32_t least = xti_first(tree, xti_right(tree, del));
+        if (del == tree->root)
+            tree->root = least;
+
+        xti_replace_right(tree, del, least);
+        xti_update(tree, xti_right(tree, least));
+    } else if (xti_left(tree, del)) {
+        uint32_t most = xti_last(tree, xti_left(tree, del));
+        if (del == tree->root)
+            tree->root = most;
+
+        xti_replace_left(tree, del, most);
+        xti_update(tree, xti_left(tree, most));
+    } else if (del == tree->root) {
+        tree->root = XTI_NIL;
+    } else {
+        /* empty node */
+        uint32_t parent = xti_parent(tree, del);
+
+        if (xti_left(tree, parent) == del)
+            xti_left(tree, parent) = XTI_NIL;
+        else
+            xti_right(tree, parent) = XTI_NIL;
+
+        xti_update(tree, parent);
+    }
+
+    xti_release(tree, del);
+    return 0;
+}
+
+/* In-order walk through the parent links, without a stack */
+size_t xti_iterate(struct xti_tree *tree, void (*cb)(int, void *), void *arg)
+{
+    uint32_t n = tree->root ? xti_first(tree, tree->root) : XTI_NIL;
+    size_t count = 0;
+
+    while (n) {
+        cb(xti_key(tree, n), arg);
+        count++;
+
+        if (xti_right(tree, n)) {
+            n = xti_first(tree, xti_right(tree, n));
+            continue;
+        }
+        uint32_t p = xti_parent(tree, n);
+        while (p && xti_right(tree, p) == n) {
+            n = p;
+            p = xti_parent(tree, p);
+        }
+        n = p;
+    }
+    return count;
+}
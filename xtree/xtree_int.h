@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Compact XTree specialized for int keys.
+ *
+ * Nodes live in one contiguous array and refer to each other by 32-bit
+ * indices instead of pointers, with the key stored inline. Index 0 is
+ * reserved as the null link. Hints are only consulted by the update phase, so
+ * they are kept in a parallel array and a node takes 16 bytes, four per cache
+ * line, against the 32 bytes of struct xt_node plus the out-of-line key of the
+ * generic tree. Lookups walk the array without indirect comparator calls.
+ *
+ * Since the array may be moved when it grows, pointers returned by xti_find()
+ * are only valid until the next insertion.
+ */
+struct xti_node {
+    int key;
+    uint32_t parent;
+    uint32_t left, right;
+};
+
+struct xti_tree {
+    struct xti_node *nodes;
+    int16_t *hints;
+    uint32_t root;
+    uint32_t free_list; /* released slots, chained through ->left */
+    uint32_t used;      /* slots handed out so far, including slot 0 */
+    uint32_t capacity;
+    uint32_t count;     /* keys in the tree */
+};
+
+struct xti_tree *xti_create(uint32_t capacity);
+void xti_destroy(struct xti_tree *tree);
+int xti_insert(struct xti_tree *tree, int key);
+int xti_remove(struct xti_tree *tree, int key);
+int *xti_find(struct xti_tree *tree, int key);
+size_t xti_iterate(struct xti_tree *tree, void (*cb)(int, void *), void *arg);
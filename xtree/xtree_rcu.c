@@ -0,0 +1,109 @@
+/*
+ * Concurrent XTree with lock-free readers, see rcu.c for the synchronization
+ * scheme. The writer side reuses xtree.c as is.
+ */
+
+#include <stdlib.h>
+
+#include "xtree_rcu.h"
+
+static void xt_rcu_free(void *ptr, void *arg)
+{
+    struct xt_tree *tree = arg;
+    tree->destroy_node(tree, ptr);
+}
+
+struct xt_rcu *xt_rcu_create(
+    cmp_t *cmp,
+    struct xt_node *(*create_node)(struct xt_tree *tree, void *key),
+    void (*destroy_node)(struct xt_tree *tree, struct xt_node *n))
+{
+    struct xt_rcu *rcu = calloc(sizeof(struct xt_rcu), 1);
+    if (!rcu)
+        return NULL;
+
+    rcu->tree = xt_create(cmp, create_node, destroy_node);
+    if (!rcu->tree) {
+        free(rcu);
+        return NULL;
+    }
+
+    rcu_init(&rcu->rcu, xt_rcu_free, rcu->tree);
+    return rcu;
+}
+
+/* No reader may be running anymore */
+void xt_rcu_destroy(struct xt_rcu *rcu)
+{
+    rcu_fini(&rcu->rcu);
+    xt_destroy(rcu->tree);
+    free(rcu);
+}
+
+int xt_rcu_insert(struct xt_rcu *rcu, void *key)
+{
+    int ret;
+
+    rcu_write_lock(&rcu->rcu);
+    ret = xt_insert(rcu->tree, key);
+    rcu_write_unlock(&rcu->rcu);
+    return ret;
+}
+
+int xt_rcu_remove(struct xt_rcu *rcu, void *key)
+{
+    struct xt_node *n;
+
+    rcu_write_lock(&rcu->rcu);
+    n = xt_find(rcu->tree, key);
+    if (n) {
+        xt_erase(n, rcu->tree);
+        rcu_retire(&rcu->rcu, n);
+    }
+    rcu_write_unlock(&rcu->rcu);
+    return n ? 0 : -1;
+}
+
+/* Only the presence of the key is returned: the node found is dereferenced
+ * inside the read-side section or under the lock, and may be reclaimed as
+ * soon as they end.
+ */
+bool xt_rcu_find(struct xt_rcu *rcu, void *key)
+{
+    struct xt_tree *tree = rcu->tree;
+    bool found;
+
+    rcu_read_lock(&rcu->rcu);
+    for (unsigned int tries = 1; tries < RCU_SPINS; tries++) {
+        unsigned int s = rcu_read_begin(&rcu->rcu);
+        if (s & 1)
+            continue;
+
+        struct xt_node *n = rcu_load(xt_root(tree));
+        unsigned int steps = 0;
+        while (n) {
+            int cmp = tree->cmp(n, key);
+            if (cmp == 0)
+                break;
+
+            /* select the link before loading it, which compiles to a
+             * conditional move like the loop of __xt_find2()
+             */
+            n = rcu_load(*(cmp > 0 ? &xt_left(n) : &xt_right(n)));
+            if (++steps % RCU_CHECK_STEPS == 0 &&
+                rcu_read_changed(&rcu->rcu, s))
+                break;
+        }
+
+        if (!rcu_read_retry(&rcu->rcu, s)) {
+            rcu_read_unlock(&rcu->rcu);
+            return n;
+        }
+    }
+    rcu_read_unlock(&rcu->rcu);
+
+    pthread_mutex_lock(&rcu->rcu.lock);
+    found = xt_find(tree, key);
+    pthread_mutex_unlock(&rcu->rcu.lock);
+    return found;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "rcu.h"
+#include "xtree.h"
+
+/* Read-mostly concurrent front-end for XTree, built on rcu.h.
+ *
+ * Writers run the regular XTree code under the write lock. Readers walk the
+ * tree without locking and retry when a writer went through meanwhile, since
+ * a rotation may have moved the key out of their path. Removed nodes reach
+ * tree->destroy_node once no reader can still hold them.
+ *
+ * Lookups only report whether the key is present: a node found by a reader
+ * may be reclaimed as soon as its read-side section ends, so it never leaves
+ * xt_rcu_find().
+ */
+struct xt_rcu {
+    struct xt_tree *tree;
+    struct rcu_domain rcu;
+};
+
+struct xt_rcu *xt_rcu_create(
+    cmp_t *cmp,
+    struct xt_node *(*create_node)(struct xt_tree *tree, void *key),
+    void (*destroy_node)(struct xt_tree *tree, struct xt_node *n));
+void xt_rcu_destroy(struct xt_rcu *rcu);
+int xt_rcu_insert(struct xt_rcu *rcu, void *key);
+int xt_rcu_remove(struct xt_rcu *rcu, void *key);
+bool xt_rcu_find(struct xt_rcu *rcu, void *key);